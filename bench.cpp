@@ -0,0 +1,572 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "map.h"
+#include "data.h"
+#include "logparser.h"
+#include "trace.h"
+#include "geojson.h"
+#include "writer.h"
+#include "visits.h"
+#include "occupancy.h"
+#include "generator.h"
+
+#include <osmium/osm/types.hpp>
+
+// Samples in every synthetic user log of the occupancy, output and pipeline benchmarks
+#define BENCH_SAMPLES 100000
+
+// Random points tested against every ring of the polygon check, on top of its vertices and points on its horizontal edges
+#define BENCH_POLYGON_POINTS 16
+
+// Ring vertices of the polygon check are snapped to this many latitude steps per radius so that many edges are horizontal
+#define BENCH_POLYGON_LEVELS 4
+
+// One measurement, every benchmark adds its results to the report written at the end of the run
+struct benchResult {
+    std::string name;     // Benchmark and what was measured, for example tiles.getBuildings
+    double size;          // Scale the benchmark ran at, grid side, megabytes or thread count depending on the benchmark
+    double value;
+    std::string unit;
+};
+
+/*
+*   Input: Time a measurement started
+*   Output: Seconds since then
+*/
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+*   Input: Side length of the building grid, number of queries to run, name and building spacing of the area, report to
+*          add to
+*   Output: Average latency of Map::getBuildings(loc), Map::getIds(loc) and Map::getNearbyBuildings(loc) printed to stdout
+*   Description: Builds a Map over a synthetic extract and times location queries at random points inside it. The random
+*                points fall in a handful of tiles, so the first pass runs with the tile cache disabled to time the tile
+*                tree itself and the second pass shows what the cache adds on top
+*/
+void benchTileQueries(int side, int queries, std::string area, double spacing, std::vector<benchResult> &report)
+{
+    std::string filename = "bench_" + std::to_string(side) + ".osm";
+    writeSyntheticOsm(side, filename, 1, spacing);
+
+    std::vector<std::vector<locationEntry>> data;
+    data.push_back(syntheticTrace(side, spacing));
+    Map map(data, filename, false);
+    remove(filename.c_str());
+
+    syntheticRandom random(side);
+    std::vector<osmium::Location> locations;
+    for(int i = 0; i < queries; i++)
+        locations.push_back(osmium::Location(random.uniform(gridLon(0, spacing), gridLon(side, spacing)),
+                                             random.uniform(gridLat(0, spacing), gridLat(side, spacing))));
+
+    size_t results = 0;
+    auto timeQueries = [&](auto query){
+        auto start = std::chrono::steady_clock::now();
+        for(auto& loc : locations)
+            results += query(loc);
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / queries;
+    };
+    auto buildings = [&map](const osmium::Location &loc){ return map.getBuildings(loc)->size(); };
+    auto ids = [&map](const osmium::Location &loc){ return map.getIds(loc)->size(); };
+
+    map.setTileCacheSize(0);
+    double buildingsUs = timeQueries(buildings);
+    double idsUs = timeQueries(ids);
+    double nearbyUs = timeQueries([&map](const osmium::Location &loc){ return map.getNearbyBuildings(loc).size(); });
+
+    map.setTileCacheSize(TILE_CACHE_SIZE);
+    double cachedBuildingsUs = timeQueries(buildings);
+    double cachedIdsUs = timeQueries(ids);
+    const tileTree &tree = map.getTileTree();
+
+    cacheStats cache = map.getTileCacheStats();
+    std::cout << "Area: " << area << " | Buildings: " << side * side << " | Uncached getBuildings: " << buildingsUs
+              << " us/query | getIds: " << idsUs << " us/query | getNearbyBuildings: " << nearbyUs << " us/query | Cached getBuildings: "
+              << cachedBuildingsUs << " us/query | getIds: " << cachedIdsUs << " us/query | Results: " << results << " | Tiles: "
+              << tree.leafCount() << " (deepest zoom " << tree.deepest() << ") | Tile cache hits: " << cache.hits << " misses: "
+              << cache.misses << std::endl;
+
+    report.push_back(benchResult{"tiles." + area + ".getBuildings", double(side), buildingsUs, "us/query"});
+    report.push_back(benchResult{"tiles." + area + ".getIds", double(side), idsUs, "us/query"});
+    report.push_back(benchResult{"tiles." + area + ".getNearbyBuildings", double(side), nearbyUs, "us/query"});
+    report.push_back(benchResult{"tiles." + area + ".cached.getBuildings", double(side), cachedBuildingsUs, "us/query"});
+    report.push_back(benchResult{"tiles." + area + ".cached.getIds", double(side), cachedIdsUs, "us/query"});
+    report.push_back(benchResult{"tiles." + area + ".leaves", double(side), double(tree.leafCount()), "tiles"});
+}
+
+/*
+*   Input: Side length of the building grid, report to add to
+*   Output: Time taken to build a Map over the synthetic extract, which is mostly gatherNodes
+*   Description: The trace visits every building, so both the extract and the set of tiles grow with the side length
+*/
+void benchLoad(int side, std::vector<benchResult> &report)
+{
+    std::string filename = "bench_" + std::to_string(side) + ".osm";
+    writeSyntheticOsm(side, filename);
+
+    std::vector<std::vector<locationEntry>> data;
+    data.push_back(syntheticTrace(side));
+
+    auto start = std::chrono::steady_clock::now();
+    Map map(data, filename, false);
+    double seconds = secondsSince(start);
+    remove(filename.c_str());
+
+    std::cout << "Buildings: " << side * side << " | Nodes: " << side * side * 4 << " | Load: " << seconds << " s | "
+              << map.bytesPerBuilding() << " bytes/building" << std::endl;
+
+    report.push_back(benchResult{"load.gatherNodes", double(side), seconds, "s"});
+    report.push_back(benchResult{"load.memory", double(side), double(map.bytesPerBuilding()), "bytes/building"});
+}
+
+/*
+*   Input: Size of the generated log in megabytes, report to add to
+*   Output: tokenizeLog throughput in MB/s for an increasing number of threads
+*/
+void benchIngest(size_t megabytes, std::vector<benchResult> &report)
+{
+    std::string filename = "bench_log.csv";
+    if(!writeSyntheticLog(megabytes, filename))
+    {
+        std::cerr << "Could not write " << filename << std::endl;
+        remove(filename.c_str());
+        return;
+    }
+
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::vector<locationEntry> data;
+        auto start = std::chrono::steady_clock::now();
+        tokenizeLog(data, filename, threads);
+        double seconds = secondsSince(start);
+
+        std::cout << "Threads: " << threads << " | Entries: " << data.size() << " | " << megabytes / seconds << " MB/s" << std::endl;
+        report.push_back(benchResult{"ingest.tokenizeLog." + std::to_string(threads), double(megabytes), megabytes / seconds, "MB/s"});
+    }
+    remove(filename.c_str());
+}
+
+/*
+*   Input: Side length of the building grid, number of users, report to add to
+*   Output: Point in building throughput of the visit tracker on synthetic walks, on a single thread
+*/
+void benchOccupancy(int side, int users, std::vector<benchResult> &report)
+{
+    std::string filename = "bench_" + std::to_string(side) + ".osm";
+    writeSyntheticOsm(side, filename);
+
+    std::vector<std::vector<locationEntry>> data;
+    data.push_back(syntheticTrace(side));
+    Map map(data, filename, false);
+    remove(filename.c_str());
+
+    std::vector<userTrace> traces;
+    for(int u = 0; u < users; u++)
+        traces.emplace_back(syntheticWalk(side, BENCH_SAMPLES, u + 1));
+
+    size_t samples = 0, visits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto& trace : traces)
+    {
+        visits += getBuildingVisits(map, trace, 0, trace.size()).size();
+        samples += trace.size();
+    }
+    double seconds = secondsSince(start);
+
+    std::cout << "Buildings: " << side * side << " | Samples: " << samples << " | Visits: " << visits << " | "
+              << samples / seconds / 1e6 << " M samples/s" << std::endl;
+    report.push_back(benchResult{"occupancy.getBuildingVisits", double(side), samples / seconds / 1e6, "M samples/s"});
+}
+
+/*
+* Input: Two vertices relative to the point
+* Output: Angle between them seen from the point
+* Description: Part of the angle sum point in polygon test the kernels in polygon.h replaced, kept as the reference
+*/
+double angle2D(double lat1, double lon1, double lat2, double lon2)
+{
+    double theta1 = atan2(lat1, lon1);
+    double theta2 = atan2(lat2, lon2);
+    double dtheta = theta2 - theta1;
+    while(dtheta > M_PI)
+        dtheta -= (M_PI * 2);
+    while(dtheta <  -M_PI)
+        dtheta += (M_PI * 2);
+    return(dtheta);
+}
+
+/*
+* Input: Closed ring of n vertices as separate latitude and longitude arrays, point latitude and longitude
+* Output: Whether or not the angles around the ring add up to a full turn
+*/
+int angleSum(const double *lat, const double *lon, size_t n, double pLat, double pLon)
+{
+    double angle = 0;
+    for(size_t i = 0; i + 1 < n; i++)
+        angle += angle2D(lat[i] - pLat, lon[i] - pLon, lat[i + 1] - pLat, lon[i + 1] - pLon);
+    return fabs(angle) >= M_PI;
+}
+
+/*
+*   Input: Number of rings to generate, report to add to
+*   Output: Whether or not every point in polygon kernel agrees, and the time per edge of each of them
+*   Description: Generates rings of 3 to 32 vertices, convex, concave and (with the vertices out of order)
+*                self-intersecting, and tests random points, every vertex and points on every horizontal edge against
+*                them with the scalar, SSE2 and AVX2 winding number kernels and the old angle sum test. The kernels must
+*                give the same winding number for every point. The angle sum test must agree with them away from the
+*                edges, on an edge it is not defined so differences there are only counted
+*/
+bool benchPolygon(int count, std::vector<benchResult> &report)
+{
+    syntheticRandom random(count);
+    polygonSet rings;
+    std::vector<double> pointLat, pointLon;
+    std::vector<uint32_t> pointRing;
+    std::vector<uint8_t> onEdge;
+    auto addPoint = [&](double lat, double lon, bool edge){
+        pointLat.push_back(lat);
+        pointLon.push_back(lon);
+        pointRing.push_back(rings.size() - 1);
+        onEdge.push_back(edge);
+    };
+
+    for(int p = 0; p < count; p++)
+    {
+        int n = 3 + random.below(30);
+        bool ordered = random.below(4) != 0;
+        size_t first = rings.lat.size();
+        for(int i = 0; i < n; i++)
+        {
+            double angle = ordered ? 2 * M_PI * (i + random.uniform(0, 0.9)) / n : random.uniform(0, 2 * M_PI);
+            double radius = random.uniform(0.3, 1.0);
+            rings.lat.push_back(BENCH_ORIGIN_LAT + BENCH_SPACING * round(radius * sin(angle) * BENCH_POLYGON_LEVELS) / BENCH_POLYGON_LEVELS);
+            rings.lon.push_back(BENCH_ORIGIN_LON + BENCH_SPACING * radius * cos(angle));
+        }
+        rings.lat.push_back(rings.lat[first]);
+        rings.lon.push_back(rings.lon[first]);
+        rings.offset.push_back(rings.lat.size());
+
+        for(int k = 0; k < BENCH_POLYGON_POINTS; k++)
+            addPoint(BENCH_ORIGIN_LAT + BENCH_SPACING * random.uniform(-1.1, 1.1),
+                     BENCH_ORIGIN_LON + BENCH_SPACING * random.uniform(-1.1, 1.1), false);
+        for(size_t i = first; i + 1 < rings.lat.size(); i++)
+        {
+            addPoint(rings.lat[i], rings.lon[i], true);
+            if(rings.lat[i] == rings.lat[i + 1])
+                addPoint(rings.lat[i], rings.lon[i] + random.uniform(0, 1) * (rings.lon[i + 1] - rings.lon[i]), true);
+        }
+    }
+    size_t edges = 0;
+    for(auto ring : pointRing)
+        edges += rings.vertexCount(ring) - 1;
+
+    typedef int (*windingKernel)(const double*, const double*, size_t, double, double);
+    auto run = [&](windingKernel kernel, std::vector<int> &counts){
+        counts.resize(pointRing.size());
+        auto start = std::chrono::steady_clock::now();
+        for(size_t k = 0; k < pointRing.size(); k++)
+        {
+            size_t first = rings.offset[pointRing[k]];
+            counts[k] = kernel(&rings.lat[first], &rings.lon[first], rings.vertexCount(pointRing[k]), pointLat[k], pointLon[k]);
+        }
+        return secondsSince(start) * 1e9 / edges;
+    };
+
+    std::vector<int> scalar, angles, simd;
+    size_t kernelMismatches = 0, angleMismatches = 0, angleEdge = 0;
+    double scalarNs = run(windingNumberScalar, scalar);
+    double angleNs = run(angleSum, angles);
+    for(size_t k = 0; k < scalar.size(); k++)
+    {
+        if((scalar[k] != 0) == (angles[k] != 0))
+            continue;
+        if(onEdge[k])
+            angleEdge++;
+        else
+            angleMismatches++;
+    }
+    report.push_back(benchResult{"polygon.scalar", double(count), scalarNs, "ns/edge"});
+    report.push_back(benchResult{"polygon.atan2", double(count), angleNs, "ns/edge"});
+    std::cout << "Rings: " << count << " | Points: " << scalar.size() << " | Edge tests: " << edges << " | Scalar: "
+              << scalarNs << " ns/edge | atan2: " << angleNs << " ns/edge";
+
+    auto compare = [&](std::string name, windingKernel kernel){
+        double ns = run(kernel, simd);
+        for(size_t k = 0; k < scalar.size(); k++)
+            kernelMismatches += simd[k] != scalar[k];
+        report.push_back(benchResult{"polygon." + name, double(count), ns, "ns/edge"});
+        std::cout << " | " << name << ": " << ns << " ns/edge";
+    };
+#if defined(__SSE2__)
+    compare("sse2", windingNumberSSE2);
+#endif
+#if defined(POLYGON_AVX2)
+    if(__builtin_cpu_supports("avx2"))
+        compare("avx2", windingNumberAVX2);
+#endif
+
+    std::cout << " | Kernel mismatches: " << kernelMismatches << " | atan2 mismatches: " << angleMismatches
+              << " (and " << angleEdge << " on an edge)" << std::endl;
+    report.push_back(benchResult{"polygon.mismatches", double(count), double(kernelMismatches + angleMismatches), "points"});
+    return kernelMismatches == 0 && angleMismatches == 0;
+}
+
+/*
+*   Input: Side length of the building grid, report to add to
+*   Output: Time taken to write the buildings and a user path in every text format
+*/
+void benchOutput(int side, std::vector<benchResult> &report)
+{
+    std::string filename = "bench_" + std::to_string(side) + ".osm";
+    writeSyntheticOsm(side, filename);
+
+    std::vector<std::vector<locationEntry>> data;
+    data.push_back(syntheticTrace(side));
+    Map map(data, filename, false);
+    remove(filename.c_str());
+
+    const buildingTable &buildings = map.getBuildings();
+    std::vector<char> entered(buildings.size(), false);
+    for(size_t i = 0; i < entered.size(); i += 7)
+        entered[i] = true;
+    userTrace path(syntheticWalk(side, BENCH_SAMPLES, 1));
+
+    const outputFormat formats[] = {FORMAT_GEOJSON, FORMAT_NDJSON, FORMAT_NDJSON_GZ};
+    const char *names[] = {"geojson", "ndjson", "ndjson.gz"};
+    for(int f = 0; f < 3; f++)
+    {
+        std::string output = std::string("bench_output") + geojsonExtension(formats[f]);
+
+        auto start = std::chrono::steady_clock::now();
+        outputJson(buildings, entered, output, formats[f]);
+        double buildingSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        outputJson(path, output, formats[f]);
+        double pathSeconds = secondsSince(start);
+        remove(output.c_str());
+
+        std::cout << "Format: " << names[f] << " | Buildings: " << buildings.size() << " in " << buildingSeconds * 1e3
+                  << " ms | Path: " << path.size() << " samples in " << pathSeconds * 1e3 << " ms" << std::endl;
+        report.push_back(benchResult{std::string("output.buildings.") + names[f], double(side), buildingSeconds * 1e3, "ms"});
+        report.push_back(benchResult{std::string("output.path.") + names[f], double(side), pathSeconds * 1e3, "ms"});
+    }
+
+    // The binary format is read back as well, so a save that loadOccupancy cannot read shows up here
+    std::vector<size_t> indices;
+    for(size_t i = 0; i < entered.size(); i++)
+        if(entered[i])
+            indices.push_back(i);
+    std::string output = "bench_output.occupancy";
+
+    auto start = std::chrono::steady_clock::now();
+    bool saved = saveOccupancy(buildings, indices, 1, output);
+    double saveSeconds = secondsSince(start);
+
+    occupancyResult loaded;
+    start = std::chrono::steady_clock::now();
+    bool matches = saved && loadOccupancy(output, loaded);
+    double loadSeconds = secondsSince(start);
+    remove(output.c_str());
+
+    matches = matches && loaded.header.user == 1 && loaded.header.buildings == buildings.size() &&
+              loaded.id.size() == indices.size();
+    for(size_t i = 0; matches && i < indices.size(); i++)
+        matches = loaded.id[i] == buildings.id[indices[i]];
+    if(!matches)
+        std::cerr << "Occupancy round trip through " << output << " failed" << std::endl;
+
+    std::cout << "Format: binary | Buildings: " << indices.size() << " saved in " << saveSeconds * 1e3 << " ms, loaded in "
+              << loadSeconds * 1e3 << " ms" << std::endl;
+    report.push_back(benchResult{"output.buildings.binary", double(side), saveSeconds * 1e3, "ms"});
+    report.push_back(benchResult{"output.load.binary", double(side), loadSeconds * 1e3, "ms"});
+}
+
+/*
+*   Input: Side length of the building grid, number of users, report to add to
+*   Output: Time taken by every stage of a full run over synthetic csv logs, without the interactive playback
+*   Description: Same stages as the main program: parse the logs, build the map, find every users visits on every
+*                hardware thread and write the results. Every file the run creates is removed afterwards
+*/
+void benchPipeline(int side, int users, std::vector<benchResult> &report)
+{
+    std::string osmFile = "bench_" + std::to_string(side) + ".osm";
+    writeSyntheticOsm(side, osmFile);
+
+    std::vector<std::string> logs;
+    for(int u = 0; u < users; u++)
+    {
+        logs.push_back("bench_user" + std::to_string(u + 1) + ".csv");
+        writeLog(syntheticWalk(side, BENCH_SAMPLES, u + 1), logs.back());
+    }
+
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    std::streambuf *console = std::cout.rdbuf();
+    std::ofstream quiet("/dev/null");
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<userTrace> data(users);
+    for(int u = 0; u < users; u++)
+        data[u].load(logs[u], workers);
+    double parseSeconds = secondsSince(start);
+
+    auto stage = std::chrono::steady_clock::now();
+    std::cout.rdbuf(quiet.rdbuf());
+    Map map(data, osmFile, false);
+    double mapSeconds = secondsSince(stage);
+
+    stage = std::chrono::steady_clock::now();
+    getOccupiedBuildings(map, data, workers, FORMAT_GEOJSON);
+    double occupancySeconds = secondsSince(stage);
+    std::cout.rdbuf(console);
+    double totalSeconds = secondsSince(start);
+
+    remove(osmFile.c_str());
+    for(int u = 0; u < users; u++)
+    {
+        remove(logs[u].c_str());
+        remove((logs[u] + ".trace").c_str());
+        remove(("user" + std::to_string(u + 1) + "buildings.geojson").c_str());
+        remove(("user" + std::to_string(u + 1) + "visits.csv").c_str());
+    }
+
+    std::cout << "Buildings: " << side * side << " | Users: " << users << " | Parse: " << parseSeconds << " s | Map: "
+              << mapSeconds << " s | Occupancy: " << occupancySeconds << " s | Total: " << totalSeconds << " s" << std::endl;
+    report.push_back(benchResult{"pipeline.parse", double(side), parseSeconds, "s"});
+    report.push_back(benchResult{"pipeline.map", double(side), mapSeconds, "s"});
+    report.push_back(benchResult{"pipeline.occupancy", double(side), occupancySeconds, "s"});
+    report.push_back(benchResult{"pipeline.total", double(side), totalSeconds, "s"});
+}
+
+/*
+*   Input: Every result of the run, name of the file to write
+*   Output: The results as a json document, along with what the numbers depend on so runs can be compared
+*/
+void writeReport(const std::vector<benchResult> &report, std::string filename)
+{
+    bufferedWriter myFile(filename);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    myFile.text("{\"threads\": ");
+    myFile.integer(std::thread::hardware_concurrency());
+#if defined(__AVX2__)
+    myFile.text(", \"simd\": \"avx2\"");
+#elif defined(__SSE2__)
+    myFile.text(", \"simd\": \"sse2\"");
+#else
+    myFile.text(", \"simd\": \"none\"");
+#endif
+    myFile.text(", \"compiler\": \"" __VERSION__ "\", \"results\": [");
+    for(size_t i = 0; i < report.size(); i++)
+    {
+        myFile.text(i == 0 ? "\n  " : ",\n  ");
+        myFile.text("{\"name\": \"");
+        myFile.text(report[i].name.c_str());
+        myFile.text("\", \"size\": ");
+        myFile.number(report[i].size);
+        myFile.text(", \"value\": ");
+        myFile.number(report[i].value);
+        myFile.text(", \"unit\": \"");
+        myFile.text(report[i].unit.c_str());
+        myFile.text("\"}");
+    }
+    myFile.text("\n]}\n");
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+    else
+        std::cout << "Results written to " << filename << std::endl;
+}
+
+/*
+*   Input: Benchmark to run (tiles, load, ingest, occupancy, polygon, output or pipeline) and its size, --users N for the
+*          number of synthetic users and --json file for the report, running ./Bench with no arguments runs all of them
+*   Output: Timings for each benchmark on stdout and in the json report (bench.json by default)
+*   Description: Tile query latency should stay roughly flat as the number of buildings grows since each query only
+*                touches the tile the location falls in, and close between suburban and downtown spacing since dense
+*                tiles are split. Load time should grow linearly with the size of the extract,
+*                from a neighbourhood (16x16 buildings) up to a metro area (1024x1024). Ingest throughput should grow
+*                with the number of threads. Occupancy throughput should not depend on the size of the extract. The
+*                exit code is 1 when the point in polygon kernels disagree
+*/
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    std::string reportFile = "bench.json";
+    int users = 8;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--users" && i + 1 < argc)
+            users = std::max(1, atoi(argv[++i]));
+        else if(arg == "--json" && i + 1 < argc)
+            reportFile = argv[++i];
+        else
+            args.push_back(arg);
+    }
+
+    std::string mode = args.size() > 0 ? args[0] : "all";
+    bool sized = args.size() > 1;
+    std::vector<benchResult> report;
+
+    if(mode == "tiles" || mode == "all")
+    {
+        int maxSide = sized ? atoi(args[1].c_str()) : 256;
+        for(int side = 16; side <= maxSide; side *= 2)
+        {
+            benchTileQueries(side, 10000, "suburban", BENCH_SPACING, report);
+            benchTileQueries(side, 10000, "downtown", BENCH_DOWNTOWN_SPACING, report);
+        }
+    }
+
+    if(mode == "load" || mode == "all")
+    {
+        int maxSide = sized ? atoi(args[1].c_str()) : 1024;
+        for(int side = 16; side <= maxSide; side *= 2)
+            benchLoad(side, report);
+    }
+
+    if(mode == "ingest" || mode == "all")
+        benchIngest(sized ? atol(args[1].c_str()) : 2048, report);
+
+    if(mode == "occupancy" || mode == "all")
+    {
+        int maxSide = sized ? atoi(args[1].c_str()) : 512;
+        for(int side = 64; side <= maxSide; side *= 2)
+            benchOccupancy(side, users, report);
+    }
+
+    bool failed = false;
+    if(mode == "polygon" || mode == "all")
+        failed = !benchPolygon(sized ? atoi(args[1].c_str()) : 10000, report);
+
+    if(mode == "output" || mode == "all")
+        benchOutput(sized ? atoi(args[1].c_str()) : 256, report);
+
+    if(mode == "pipeline" || mode == "all")
+        benchPipeline(sized ? atoi(args[1].c_str()) : 256, users, report);
+
+    if(report.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [tiles|load|ingest|occupancy|polygon|output|pipeline|all] [size] [--users N] [--json file]" << std::endl;
+        return 1;
+    }
+
+    writeReport(report, reportFile);
+    return failed ? 1 : 0;
+}
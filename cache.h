@@ -0,0 +1,133 @@
+#ifndef CACHE_SRC
+#define CACHE_SRC
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <unordered_map>
+#include <stdint.h>
+#include "profile.h"
+
+// Counters of a cache, used to pick a capacity that suits the traces being processed
+struct cacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+};
+
+// Bounded map from keys to shared read only values, the least recently used value is evicted once it is full
+// Values are handed out as shared pointers so an evicted value stays alive for as long as a caller still holds it
+// Safe to use from several threads at once
+template <typename Key, typename Value>
+class lruCache
+{
+    public:
+        lruCache(size_t capacity);
+        template <typename Compute>
+        std::shared_ptr<const Value> get(const Key &key, Compute compute);
+        void resize(size_t capacity);
+        void clear();
+        cacheStats stats() const;
+
+    private:
+        typedef std::pair<Key, std::shared_ptr<const Value>> entry;
+        void evict();
+        std::list<entry> order;                                               // Most recently used first
+        std::unordered_map<Key, typename std::list<entry>::iterator> lookup;
+        size_t capacity;
+        cacheStats counters;
+        mutable std::mutex lock;
+};
+
+/*
+*   Input: Largest number of values to keep, 0 disables caching
+*   Output: Empty cache
+*/
+template <typename Key, typename Value>
+lruCache<Key, Value>::lruCache(size_t capacity) : capacity(capacity)
+{
+}
+
+/*
+*   Input: Key and a function that computes the value for that key
+*   Output: The cached value, or the newly computed one if the key was not cached
+*   Description: The value is computed without holding the lock, if another thread cached the same key in the meantime
+*                its value is used instead so every caller sees the same copy
+*/
+template <typename Key, typename Value>
+template <typename Compute>
+std::shared_ptr<const Value> lruCache<Key, Value>::get(const Key &key, Compute compute)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = lookup.find(key);
+        if(found != lookup.end()){
+            counters.hits++;
+            PROFILE_COUNT(PROFILE_CACHE_HITS, 1);
+            order.splice(order.begin(), order, found->second);
+            return found->second->second;
+        }
+        counters.misses++;
+        PROFILE_COUNT(PROFILE_CACHE_MISSES, 1);
+    }
+
+    std::shared_ptr<const Value> value = std::make_shared<const Value>(compute());
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(capacity == 0)
+        return value;
+    auto found = lookup.find(key);
+    if(found != lookup.end())
+        return found->second->second;
+
+    order.emplace_front(key, value);
+    lookup[key] = order.begin();
+    evict();
+    return value;
+}
+
+/*
+*   Input: Nothing
+*   Output: Nothing
+*   Description: Drops least recently used values until the cache fits its capacity. Called with the lock held
+*/
+template <typename Key, typename Value>
+void lruCache<Key, Value>::evict()
+{
+    while(order.size() > capacity){
+        lookup.erase(order.back().first);
+        order.pop_back();
+        counters.evictions++;
+    }
+}
+
+template <typename Key, typename Value>
+void lruCache<Key, Value>::resize(size_t value)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    capacity = value;
+    evict();
+}
+
+template <typename Key, typename Value>
+void lruCache<Key, Value>::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    order.clear();
+    lookup.clear();
+}
+
+template <typename Key, typename Value>
+cacheStats lruCache<Key, Value>::stats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    cacheStats result = counters;
+    result.size = order.size();
+    result.capacity = capacity;
+    return result;
+}
+
+#endif
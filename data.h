@@ -3,6 +3,13 @@
 
 #include <vector>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <algorithm>
+#include <initializer_list>
+#include <unordered_map>
+#include <stdint.h>
 #include <osmium/osm/types.hpp>
 #include <osmium/geom/tile.hpp>
 
@@ -17,40 +24,145 @@ struct locationEntry {
     double gpsAlt;
 };
 
-struct building {
-    osmium::Location location;                   // Used for nodes that represent buildings
-    std::vector<osmium::Location> nodeLocations; // Used when a way represents the building
-    std::vector<int> nodeIds;                    // Used when a way represents the building
-    std::string type;
-    std::string street;
-    std::string houseNumber;
-    std::string postalCode;
-    std::string height;
-    std::string name;
-    bool entered = false;
-};
+// Every distinct tag value stored once. Street names, building types and postcodes repeat across thousands of
+// buildings, so records hold a 32 bit index into the pool instead of a string of their own
+class stringPool {
+    public:
+        stringPool() { intern(""); }
+        stringPool(const stringPool &other) { *this = other; }
+        stringPool(stringPool&&) = default;
+        stringPool& operator=(stringPool&&) = default;
+        stringPool& operator=(const stringPool &other){
+            if(this != &other){
+                strings.clear();
+                lookup.clear();
+                for(auto& s : other.strings)
+                    intern(s);
+            }
+            return *this;
+        }
 
-struct highway {
-    std::vector<int> nodeIds;
-    std::string type;
-    std::string name;
-};
+        // Index of the value, adding it to the pool the first time it is seen. Index 0 is always the empty string
+        uint32_t intern(std::string_view value){
+            auto found = lookup.find(value);
+            if(found != lookup.end())
+                return found->second;
+
+            uint32_t id = strings.size();
+            strings.emplace_back(value);
+            lookup.emplace(strings.back(), id);
+            return id;
+        }
+        const std::string& get(uint32_t id) const{
+            return strings[id];
+        }
+        size_t size() const{
+            return strings.size();
+        }
+        size_t usedMemory() const{
+            size_t bytes = strings.size() * (sizeof(std::string) + sizeof(std::pair<std::string_view, uint32_t>) + sizeof(void*));
+            for(auto& s : strings)
+                bytes += s.capacity() > 15 ? s.capacity() + 1 : 0;
+            return bytes + lookup.bucket_count() * sizeof(void*);
+        }
 
-struct featurePolygon {
-    std::string type;
-    std::vector<std::string> coordinates;
-    bool entered = false;
+    private:
+        std::deque<std::string> strings;                          // A deque never moves its elements, so the views stay valid
+        std::unordered_map<std::string_view, uint32_t> lookup;
 };
 
-struct featureMultiLineString {
-    std::string type;
-    std::vector<std::string> coordinates1;
-    std::vector<std::string> coordinates2;
+// Every building stored column by column, building i is row i of every column
+struct buildingTable {
+    std::vector<osmium::object_id_type> id;       // Id of the node or way that represents the building
+    std::vector<osmium::Location> location;       // Used for nodes that represent buildings, undefined otherwise
+    std::vector<uint32_t> vertexOffset{0};        // Outline of building i is vertices[vertexOffset[i]] up to vertices[vertexOffset[i + 1]]
+    std::vector<osmium::Location> vertices;       // Used when a way represents the building
+    std::vector<uint32_t> type;                   // Tag values, as indices into the tag pool
+    std::vector<uint32_t> street;
+    std::vector<uint32_t> houseNumber;
+    std::vector<uint32_t> postalCode;
+    std::vector<uint32_t> height;
+    std::vector<uint32_t> name;
+
+    size_t size() const{
+        return id.size();
+    }
+    uint32_t vertexCount(size_t i) const{
+        return vertexOffset[i + 1] - vertexOffset[i];
+    }
+    const osmium::Location* outline(size_t i) const{
+        return vertices.data() + vertexOffset[i];
+    }
+    void shrinkToFit(){
+        id.shrink_to_fit();
+        for(auto column : {&location, &vertices})
+            column->shrink_to_fit();
+        for(auto column : {&vertexOffset, &type, &street, &houseNumber, &postalCode, &height, &name})
+            column->shrink_to_fit();
+    }
+    // Whether every column has a row per building, the offsets are in order and every tag index is below tagCount
+    bool consistent(size_t tagCount) const{
+        size_t n = id.size();
+        for(auto column : {&type, &street, &houseNumber, &postalCode, &height, &name}){
+            if(column->size() != n)
+                return false;
+            for(auto& tag : *column)
+                if(tag >= tagCount)
+                    return false;
+        }
+        if(location.size() != n || vertexOffset.size() != n + 1 || vertexOffset[0] != 0 || vertexOffset[n] != vertices.size())
+            return false;
+        return std::is_sorted(vertexOffset.begin(), vertexOffset.end());
+    }
+    size_t usedMemory() const{
+        return id.capacity() * sizeof(osmium::object_id_type) + location.capacity() * sizeof(osmium::Location) +
+               vertexOffset.capacity() * sizeof(uint32_t) + vertices.capacity() * sizeof(osmium::Location) +
+               (type.capacity() + street.capacity() + houseNumber.capacity() + postalCode.capacity() +
+                height.capacity() + name.capacity()) * sizeof(uint32_t);
+    }
 };
 
-struct featureLineString {
-    std::string type;
-    std::string user;
-    std::vector<std::string> coordinates;
+// Every highway stored column by column, highway i is row i of every column
+struct highwayTable {
+    std::vector<osmium::object_id_type> id;       // Id of the way
+    std::vector<uint32_t> nodeOffset{0};          // Nodes of highway i are nodeIds[nodeOffset[i]] up to nodeIds[nodeOffset[i + 1]]
+    std::vector<osmium::object_id_type> nodeIds;
+    std::vector<uint32_t> type;                   // Tag values, as indices into the tag pool
+    std::vector<uint32_t> name;
+
+    size_t size() const{
+        return id.size();
+    }
+    uint32_t nodeCount(size_t i) const{
+        return nodeOffset[i + 1] - nodeOffset[i];
+    }
+    const osmium::object_id_type* nodes(size_t i) const{
+        return nodeIds.data() + nodeOffset[i];
+    }
+    void shrinkToFit(){
+        for(auto column : {&id, &nodeIds})
+            column->shrink_to_fit();
+        for(auto column : {&nodeOffset, &type, &name})
+            column->shrink_to_fit();
+    }
+    // Whether every column has a row per highway, the offsets are in order and every tag index is below tagCount
+    bool consistent(size_t tagCount) const{
+        size_t n = id.size();
+        for(auto column : {&type, &name}){
+            if(column->size() != n)
+                return false;
+            for(auto& tag : *column)
+                if(tag >= tagCount)
+                    return false;
+        }
+        if(nodeOffset.size() != n + 1 || nodeOffset[0] != 0 || nodeOffset[n] != nodeIds.size())
+            return false;
+        return std::is_sorted(nodeOffset.begin(), nodeOffset.end());
+    }
+    size_t usedMemory() const{
+        return (id.capacity() + nodeIds.capacity()) * sizeof(osmium::object_id_type) +
+               (nodeOffset.capacity() + type.capacity() + name.capacity()) * sizeof(uint32_t);
+    }
 };
+
 #endif
\ No newline at end of file
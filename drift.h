@@ -0,0 +1,396 @@
+#ifndef DRIFT_SRC
+#define DRIFT_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <cmath>
+#include <math.h>
+#include "trace.h"
+#include "writer.h"
+#include "threadpool.h"
+#include "profile.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Radius of the earth in metres, same value as the map uses
+#ifndef EARTH_RADIUS
+#define EARTH_RADIUS 6371008.8
+#endif
+
+// Largest latitude or longitude difference in radians (about 127 km) handled by the polynomial haversine, samples
+// further apart than this go through the exact formula instead
+#define DRIFT_POLYNOMIAL 0.02
+
+// Seconds of log per bin of the error against time series, widened when a trace would need more than DRIFT_MAX_BINS
+#define DRIFT_BIN 60.0
+#define DRIFT_MAX_BINS 100000
+
+// Error between the navisens and gps tracks of a single user
+struct driftSummary {
+    size_t samples = 0;
+    size_t valid = 0;         // Samples with a finite error
+    double mean = 0;          // Metres
+    double p50 = 0;
+    double p90 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+    double rate = 0;          // Least squares slope of the error against time, metres per minute
+};
+
+// Mean and largest error of the samples in one bin of the error against time series
+struct driftBin {
+    double start;
+    size_t samples = 0;
+    double mean = 0;
+    double max = 0;
+};
+
+/*
+*   Input: Latitude and longitude of two points in degrees
+*   Output: Great circle distance between them in metres
+*/
+inline double haversine(double lat1, double lon1, double lat2, double lon2)
+{
+    const double radians = M_PI / 180.0;
+    double sinLat = sin((lat2 - lat1) * radians * 0.5);
+    double sinLon = sin((lon2 - lon1) * radians * 0.5);
+    double a = sinLat * sinLat + cos(lat1 * radians) * cos(lat2 * radians) * sinLon * sinLon;
+    // Rounding can push the term just past 1 for antipodal points, written so a NaN still comes out as NaN
+    double s = sqrt(a);
+    if(s > 1.0)
+        s = 1.0;
+    return 2.0 * EARTH_RADIUS * asin(s);
+}
+
+/*
+*   Input: Angle in radians, at most DRIFT_POLYNOMIAL
+*   Output: Sine of the angle, the first omitted term is below 1e-17 of the result
+*/
+inline double smallSine(double x)
+{
+    double x2 = x * x;
+    return x * (1.0 + x2 * (-1.0 / 6 + x2 * (1.0 / 120 + x2 * (-1.0 / 5040))));
+}
+
+/*
+*   Input: Latitude in radians
+*   Output: Cosine of the latitude, Taylor series in x squared accurate to about 1e-15 over [-pi/2, pi/2]
+*/
+inline double latitudeCosine(double x)
+{
+    double x2 = x * x;
+    double c = -1.0 / 6402373705728000.0;
+    c = c * x2 + 1.0 / 20922789888000.0;
+    c = c * x2 - 1.0 / 87178291200.0;
+    c = c * x2 + 1.0 / 479001600.0;
+    c = c * x2 - 1.0 / 3628800.0;
+    c = c * x2 + 1.0 / 40320.0;
+    c = c * x2 - 1.0 / 720.0;
+    c = c * x2 + 1.0 / 24.0;
+    c = c * x2 - 1.0 / 2.0;
+    return c * x2 + 1.0;
+}
+
+/*
+*   Input: Square root of the haversine term, at most about DRIFT_POLYNOMIAL
+*   Output: Arcsine of it, the first omitted term is below 1e-17 of the result
+*/
+inline double smallArcsine(double s)
+{
+    double s2 = s * s;
+    return s * (1.0 + s2 * (1.0 / 6 + s2 * (3.0 / 40 + s2 * (5.0 / 112 + s2 * (35.0 / 1152)))));
+}
+
+/*
+*   Input: Navisens and gps coordinates of a sample in degrees
+*   Output: Distance between them in metres
+*   Description: Scalar form of the polynomial kernel, used for the samples left over after the SIMD loop
+*/
+inline double driftDistance(double navLat, double navLon, double gpsLat, double gpsLon)
+{
+    const double radians = M_PI / 180.0;
+    double dLat = (gpsLat - navLat) * radians;
+    double dLon = (gpsLon - navLon) * radians;
+    if(!(fabs(dLat) <= DRIFT_POLYNOMIAL && fabs(dLon) <= DRIFT_POLYNOMIAL && fabs(navLat) <= 90.0 && fabs(gpsLat) <= 90.0))
+        return haversine(navLat, navLon, gpsLat, gpsLon);
+
+    double sinLat = smallSine(dLat * 0.5);
+    double sinLon = smallSine(dLon * 0.5);
+    double a = sinLat * sinLat + latitudeCosine(navLat * radians) * latitudeCosine(gpsLat * radians) * sinLon * sinLon;
+    return 2.0 * EARTH_RADIUS * smallArcsine(sqrt(a));
+}
+
+#if defined(__AVX2__)
+inline __m256d smallSine(__m256d x)
+{
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d c = _mm256_set1_pd(-1.0 / 5040);
+    c = _mm256_add_pd(_mm256_mul_pd(c, x2), _mm256_set1_pd(1.0 / 120));
+    c = _mm256_add_pd(_mm256_mul_pd(c, x2), _mm256_set1_pd(-1.0 / 6));
+    c = _mm256_add_pd(_mm256_mul_pd(c, x2), _mm256_set1_pd(1.0));
+    return _mm256_mul_pd(c, x);
+}
+
+inline __m256d latitudeCosine(__m256d x)
+{
+    static const double terms[] = {-1.0 / 6402373705728000.0, 1.0 / 20922789888000.0, -1.0 / 87178291200.0,
+                                   1.0 / 479001600.0, -1.0 / 3628800.0, 1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0,
+                                   -1.0 / 2.0, 1.0};
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d c = _mm256_set1_pd(terms[0]);
+    for(int i = 1; i < 10; i++)
+        c = _mm256_add_pd(_mm256_mul_pd(c, x2), _mm256_set1_pd(terms[i]));
+    return c;
+}
+
+inline __m256d smallArcsine(__m256d s)
+{
+    __m256d s2 = _mm256_mul_pd(s, s);
+    __m256d c = _mm256_set1_pd(35.0 / 1152);
+    c = _mm256_add_pd(_mm256_mul_pd(c, s2), _mm256_set1_pd(5.0 / 112));
+    c = _mm256_add_pd(_mm256_mul_pd(c, s2), _mm256_set1_pd(3.0 / 40));
+    c = _mm256_add_pd(_mm256_mul_pd(c, s2), _mm256_set1_pd(1.0 / 6));
+    c = _mm256_add_pd(_mm256_mul_pd(c, s2), _mm256_set1_pd(1.0));
+    return _mm256_mul_pd(c, s);
+}
+#endif
+
+/*
+*   Input: Trace of a user, array of trace.size() values to hold the error of every sample
+*   Output: Nothing
+*   Description: Distance in metres between the navisens and gps location of every sample. The haversine formula is
+*                evaluated with polynomials instead of sin/cos/asin so four (AVX2) samples are handled per iteration.
+*                Lanes whose points are too far apart for the polynomials (or not valid coordinates) are redone with
+*                the exact formula, so the result never depends on which path was taken by more than rounding
+*/
+void driftErrors(const userTrace &trace, double *error)
+{
+    PROFILE_SCOPE(PROFILE_DRIFT);
+    const double *navLat = trace.navLat();
+    const double *navLon = trace.navLon();
+    const double *gpsLat = trace.gpsLat();
+    const double *gpsLon = trace.gpsLon();
+    size_t n = trace.size();
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256d radians = _mm256_set1_pd(M_PI / 180.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d limit = _mm256_set1_pd(DRIFT_POLYNOMIAL);
+    const __m256d pole = _mm256_set1_pd(90.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d diameter = _mm256_set1_pd(2.0 * EARTH_RADIUS);
+    for(; i + 4 <= n; i += 4){
+        __m256d lat1 = _mm256_loadu_pd(navLat + i);
+        __m256d lon1 = _mm256_loadu_pd(navLon + i);
+        __m256d lat2 = _mm256_loadu_pd(gpsLat + i);
+        __m256d lon2 = _mm256_loadu_pd(gpsLon + i);
+
+        __m256d dLat = _mm256_mul_pd(_mm256_sub_pd(lat2, lat1), radians);
+        __m256d dLon = _mm256_mul_pd(_mm256_sub_pd(lon2, lon1), radians);
+
+        // Ordered compares are false for NaN, so invalid samples also end up on the exact path
+        __m256d inRange = _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, dLat), limit, _CMP_LE_OQ),
+                                        _mm256_cmp_pd(_mm256_andnot_pd(sign, dLon), limit, _CMP_LE_OQ));
+        inRange = _mm256_and_pd(inRange, _mm256_cmp_pd(_mm256_andnot_pd(sign, lat1), pole, _CMP_LE_OQ));
+        inRange = _mm256_and_pd(inRange, _mm256_cmp_pd(_mm256_andnot_pd(sign, lat2), pole, _CMP_LE_OQ));
+
+        __m256d sinLat = smallSine(_mm256_mul_pd(dLat, half));
+        __m256d sinLon = smallSine(_mm256_mul_pd(dLon, half));
+        __m256d cosines = _mm256_mul_pd(latitudeCosine(_mm256_mul_pd(lat1, radians)),
+                                        latitudeCosine(_mm256_mul_pd(lat2, radians)));
+        __m256d a = _mm256_add_pd(_mm256_mul_pd(sinLat, sinLat),
+                                  _mm256_mul_pd(cosines, _mm256_mul_pd(sinLon, sinLon)));
+        _mm256_storeu_pd(error + i, _mm256_mul_pd(diameter, smallArcsine(_mm256_sqrt_pd(a))));
+
+        int mask = _mm256_movemask_pd(inRange);
+        if(mask != 0xF)
+            for(int lane = 0; lane < 4; lane++)
+                if(!(mask & (1 << lane)))
+                    error[i + lane] = haversine(navLat[i + lane], navLon[i + lane], gpsLat[i + lane], gpsLon[i + lane]);
+    }
+#endif
+
+    for(; i < n; i++)
+        error[i] = driftDistance(navLat[i], navLon[i], gpsLat[i], gpsLon[i]);
+}
+
+/*
+*   Input: Trace of a user, error of every sample, vector to hold the error against time series
+*   Output: Summary of the error of the user
+*   Description: Percentiles come from nth_element on a copy of the finite errors, each one only searching the part
+*                above the previous one, so the whole summary is linear in the number of samples
+*/
+driftSummary summarizeDrift(const userTrace &trace, const double *error, std::vector<driftBin> &bins)
+{
+    driftSummary summary;
+    summary.samples = trace.size();
+    bins.clear();
+
+    const double *timestamp = trace.timestamp();
+    std::vector<double> sorted;
+    sorted.reserve(trace.size());
+
+    double first = std::numeric_limits<double>::infinity(), last = -std::numeric_limits<double>::infinity();
+    double sumT = 0, sumE = 0, sumTT = 0, sumTE = 0;
+    for(size_t i = 0; i < trace.size(); i++)
+    {
+        if(!std::isfinite(error[i]) || !std::isfinite(timestamp[i]))
+            continue;
+        sorted.push_back(error[i]);
+        first = std::min(first, timestamp[i]);
+        last = std::max(last, timestamp[i]);
+    }
+
+    summary.valid = sorted.size();
+    if(sorted.empty())
+        return summary;
+
+    // Times are taken relative to the first sample so the sums keep their precision on epoch timestamps
+    for(size_t i = 0; i < trace.size(); i++)
+    {
+        if(!std::isfinite(error[i]) || !std::isfinite(timestamp[i]))
+            continue;
+        double t = timestamp[i] - first;
+        sumT += t;
+        sumE += error[i];
+        sumTT += t * t;
+        sumTE += t * error[i];
+    }
+    double count = static_cast<double>(sorted.size());
+    summary.mean = sumE / count;
+    double spread = sumTT - sumT * sumT / count;
+    if(spread > 0)
+        summary.rate = (sumTE - sumT * sumE / count) / spread * 60.0;
+
+    // Error against time, in fixed width bins from the first sample
+    double width = std::max(DRIFT_BIN, (last - first) / DRIFT_MAX_BINS);
+    bins.resize(static_cast<size_t>((last - first) / width) + 1);
+    for(size_t b = 0; b < bins.size(); b++)
+        bins[b].start = first + b * width;
+    for(size_t i = 0; i < trace.size(); i++)
+    {
+        if(!std::isfinite(error[i]) || !std::isfinite(timestamp[i]))
+            continue;
+        driftBin &bin = bins[std::min(bins.size() - 1, static_cast<size_t>((timestamp[i] - first) / width))];
+        bin.samples++;
+        bin.mean += error[i];
+        bin.max = std::max(bin.max, error[i]);
+    }
+    for(auto& bin : bins)
+        if(bin.samples > 0)
+            bin.mean /= bin.samples;
+
+    const double ranks[] = {0.5, 0.9, 0.95, 0.99};
+    double *values[] = {&summary.p50, &summary.p90, &summary.p95, &summary.p99};
+    auto from = sorted.begin();
+    for(int r = 0; r < 4; r++)
+    {
+        auto nth = sorted.begin() + static_cast<size_t>(ranks[r] * (sorted.size() - 1));
+        std::nth_element(from, nth, sorted.end());
+        *values[r] = *nth;
+        from = nth;
+    }
+    summary.max = *std::max_element(from, sorted.end());
+
+    return summary;
+}
+
+/*
+*   Input: Error against time series of a user, unique user identifier
+*   Output: userNdrift.csv with the start, sample count, mean and largest error of every bin that has samples
+*/
+void outputDrift(const std::vector<driftBin> &bins, int usernum)
+{
+    std::string filename = "user" + std::to_string(usernum) + "drift.csv";
+    bufferedWriter myFile(filename);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    myFile.text("Timestamp,Samples,Mean Error,Max Error\n");
+    for(auto& bin : bins)
+    {
+        if(bin.samples == 0)
+            continue;
+        myFile.number(bin.start);
+        myFile.text(",");
+        myFile.integer(bin.samples);
+        myFile.text(",");
+        myFile.number(bin.mean);
+        myFile.text(",");
+        myFile.number(bin.max);
+        myFile.text("\n");
+    }
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+/*
+*   Input: Every users trace, number of worker threads
+*   Output: userNdrift.csv per user and drift.csv with one summary line per user
+*   Description: Users are analysed in parallel, each one in a single pass of the error kernel over its columns
+*/
+void analyzeDrift(std::vector<userTrace> &data, int workers)
+{
+    std::vector<driftSummary> summaries(data.size());
+    threadPool pool(workers);
+    std::mutex outputLock;
+    std::cout << "Comparing navisens and gps tracks of " << data.size() << " users on " << pool.size() << " threads" << std::endl;
+
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        pool.submit([&data, &summaries, &outputLock, i]{
+            std::vector<double> error(data[i].size());
+            std::vector<driftBin> bins;
+            driftErrors(data[i], error.data());
+            summaries[i] = summarizeDrift(data[i], error.data(), bins);
+            outputDrift(bins, i + 1);
+
+            std::lock_guard<std::mutex> guard(outputLock);
+            std::cout << "User " << i + 1 << " median error " << summaries[i].p50 << " m, 95th percentile "
+                      << summaries[i].p95 << " m" << std::endl;
+        });
+    }
+    pool.wait();
+
+    std::string filename = "drift.csv";
+    bufferedWriter myFile(filename);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    myFile.text("User,Samples,Valid,Mean,P50,P90,P95,P99,Max,Rate\n");
+    for(size_t i = 0; i < summaries.size(); i++)
+    {
+        const driftSummary &s = summaries[i];
+        myFile.integer(i + 1);
+        myFile.text(",");
+        myFile.integer(s.samples);
+        myFile.text(",");
+        myFile.integer(s.valid);
+        for(double value : {s.mean, s.p50, s.p90, s.p95, s.p99, s.max, s.rate})
+        {
+            myFile.text(",");
+            myFile.number(value);
+        }
+        myFile.text("\n");
+    }
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+#endif
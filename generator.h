@@ -0,0 +1,248 @@
+#ifndef GENERATOR_SRC
+#define GENERATOR_SRC
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "data.h"
+
+// Spacing between neighbouring synthetic buildings in degrees, roughly 20 meters in a suburb and 5 meters downtown
+#define BENCH_SPACING 0.0002
+#define BENCH_DOWNTOWN_SPACING 0.00005
+#define BENCH_ORIGIN_LAT 40.0
+#define BENCH_ORIGIN_LON -80.0
+
+// Buildings between two neighbouring streets in either direction
+#define BENCH_BLOCK 4
+
+// Samples per second of the synthetic logs and walking speed in degrees per second (about 1.4 m/s)
+#define BENCH_RATE 10.0
+#define BENCH_SPEED 0.0000126
+
+// Shortest and longest stay inside a building in seconds, and how many buildings away the next one can be
+#define BENCH_DWELL_MIN 30.0
+#define BENCH_DWELL_MAX 300.0
+#define BENCH_WANDER 8
+
+// Deterministic random numbers for the generators. Only the raw mt19937 output is used, which the standard fixes,
+// so the same seed gives the same extract and traces with every compiler and standard library
+class syntheticRandom
+{
+    public:
+        syntheticRandom(uint32_t seed) : rng(seed) {}
+        double uniform(double low, double high) { return low + (high - low) * (rng() * (1.0 / 4294967296.0)); }
+        int below(int count) { return static_cast<int>(rng() % static_cast<uint32_t>(count)); }
+
+    private:
+        std::mt19937 rng;
+};
+
+/*
+*   Input: Row and column of a building in the grid, spacing of the grid
+*   Output: Centre of the building
+*/
+inline double gridLat(int row, double spacing = BENCH_SPACING) { return BENCH_ORIGIN_LAT + row * spacing; }
+inline double gridLon(int column, double spacing = BENCH_SPACING) { return BENCH_ORIGIN_LON + column * spacing; }
+
+/*
+*   Input: Side length of the building grid, name of the file to write, seed and spacing of the grid
+*   Output: An osm file containing side * side buildings laid out on a regular grid with a street every BENCH_BLOCK
+*           buildings in both directions
+*   Description: Generates a synthetic city extract with a constant building density, so growing the side length
+*                grows the extract without changing how many buildings share a tile. Building sizes vary a little so
+*                outlines are not all identical, but never enough for neighbouring buildings to touch
+*/
+void writeSyntheticOsm(int side, std::string filename, uint32_t seed = 1, double spacing = BENCH_SPACING)
+{
+    syntheticRandom random(seed);
+    std::ofstream myFile(filename);
+    myFile.precision(10);
+    myFile << "<?xml version='1.0' encoding='UTF-8'?>\n<osm version=\"0.6\" generator=\"bench\">\n";
+
+    long id = 1;
+    for(int i = 0; i < side; i++)
+    {
+        for(int j = 0; j < side; j++)
+        {
+            double lat = gridLat(i, spacing);
+            double lon = gridLon(j, spacing);
+            double halfLat = spacing / 4 * random.uniform(0.6, 1.4);
+            double halfLon = spacing / 4 * random.uniform(0.6, 1.4);
+            myFile << " <node id=\"" << id     << "\" lat=\"" << lat - halfLat << "\" lon=\"" << lon - halfLon << "\"/>\n";
+            myFile << " <node id=\"" << id + 1 << "\" lat=\"" << lat - halfLat << "\" lon=\"" << lon + halfLon << "\"/>\n";
+            myFile << " <node id=\"" << id + 2 << "\" lat=\"" << lat + halfLat << "\" lon=\"" << lon + halfLon << "\"/>\n";
+            myFile << " <node id=\"" << id + 3 << "\" lat=\"" << lat + halfLat << "\" lon=\"" << lon - halfLon << "\"/>\n";
+            id += 4;
+        }
+    }
+
+    // Streets run half way between two rows (or columns) of buildings, every crossing is a node shared by both streets
+    int streets = (side + BENCH_BLOCK - 1) / BENCH_BLOCK + 1;
+    long streetNodes = id;
+    for(int r = 0; r < streets; r++)
+        for(int c = 0; c < streets; c++)
+            myFile << " <node id=\"" << id++ << "\" lat=\"" << gridLat(r * BENCH_BLOCK, spacing) - spacing / 2
+                   << "\" lon=\"" << gridLon(c * BENCH_BLOCK, spacing) - spacing / 2 << "\"/>\n";
+
+    long nodeId = 1;
+    for(int i = 0; i < side * side; i++)
+    {
+        myFile << " <way id=\"" << i + 1 << "\">";
+        for(int k = 0; k < 4; k++)
+            myFile << "<nd ref=\"" << nodeId + k << "\"/>";
+        myFile << "<nd ref=\"" << nodeId << "\"/><tag k=\"building\" v=\"yes\"/></way>\n";
+        nodeId += 4;
+    }
+
+    long wayId = side * side + 1;
+    for(int s = 0; s < streets; s++)
+    {
+        myFile << " <way id=\"" << wayId++ << "\">";
+        for(int c = 0; c < streets; c++)
+            myFile << "<nd ref=\"" << streetNodes + s * streets + c << "\"/>";
+        myFile << "<tag k=\"highway\" v=\"residential\"/></way>\n";
+
+        myFile << " <way id=\"" << wayId++ << "\">";
+        for(int r = 0; r < streets; r++)
+            myFile << "<nd ref=\"" << streetNodes + r * streets + s << "\"/>";
+        myFile << "<tag k=\"highway\" v=\"residential\"/></way>\n";
+    }
+    myFile << "</osm>\n";
+    myFile.close();
+}
+
+/*
+*   Input: Side length and spacing of the building grid
+*   Output: A single user trace that visits the center of every building in the grid
+*   Description: Used so the Map covers every tile of the synthetic extract
+*/
+std::vector<locationEntry> syntheticTrace(int side, double spacing = BENCH_SPACING)
+{
+    std::vector<locationEntry> trace;
+    for(int i = 0; i < side; i++)
+    {
+        for(int j = 0; j < side; j++)
+        {
+            locationEntry temp;
+            temp.timestamp = trace.size();
+            temp.navLat = temp.gpsLat = gridLat(i, spacing);
+            temp.navLon = temp.gpsLon = gridLon(j, spacing);
+            temp.navAlt = temp.gpsAlt = 0;
+            trace.push_back(temp);
+        }
+    }
+    return trace;
+}
+
+/*
+*   Input: Side length of the building grid, number of samples and seed
+*   Output: Log of one user walking around the synthetic extract at BENCH_RATE samples per second
+*   Description: The user walks in a straight line to a building at most BENCH_WANDER buildings away, stays inside it
+*                for a while and moves on. The gps location is the true one plus a few metres of noise, the navisens
+*                location slowly drifts away from it the way dead reckoning does
+*/
+std::vector<locationEntry> syntheticWalk(int side, size_t samples, uint32_t seed)
+{
+    syntheticRandom random(seed);
+    std::vector<locationEntry> trace;
+    trace.reserve(samples);
+
+    int row = random.below(side), column = random.below(side);
+    double lat = gridLat(row), lon = gridLon(column);
+    double driftLat = 0, driftLon = 0;
+    double step = BENCH_SPEED / BENCH_RATE;
+    size_t dwell = 0;
+
+    for(size_t i = 0; i < samples; i++)
+    {
+        if(dwell > 0)
+        {
+            dwell--;
+        }else{
+            double dLat = gridLat(row) - lat, dLon = gridLon(column) - lon;
+            double distance = sqrt(dLat * dLat + dLon * dLon);
+            if(distance <= step)
+            {
+                // Arrived, stay for a while then pick the next building
+                lat = gridLat(row);
+                lon = gridLon(column);
+                dwell = static_cast<size_t>(random.uniform(BENCH_DWELL_MIN, BENCH_DWELL_MAX) * BENCH_RATE);
+                row = std::min(side - 1, std::max(0, row + random.below(2 * BENCH_WANDER + 1) - BENCH_WANDER));
+                column = std::min(side - 1, std::max(0, column + random.below(2 * BENCH_WANDER + 1) - BENCH_WANDER));
+            }else{
+                lat += dLat / distance * step;
+                lon += dLon / distance * step;
+            }
+        }
+
+        driftLat += random.uniform(-1, 1) * step * 0.01;
+        driftLon += random.uniform(-1, 1) * step * 0.01;
+
+        locationEntry entry;
+        entry.timestamp = i / BENCH_RATE;
+        entry.navLat = lat + driftLat;
+        entry.navLon = lon + driftLon;
+        entry.navAlt = 250.0 + random.uniform(-0.5, 0.5);
+        entry.gpsLat = lat + random.uniform(-0.00003, 0.00003);
+        entry.gpsLon = lon + random.uniform(-0.00003, 0.00003);
+        entry.gpsAlt = 250.0 + random.uniform(-3, 3);
+        trace.push_back(entry);
+    }
+    return trace;
+}
+
+/*
+*   Input: Log of a user and name of the file to write
+*   Output: Whether or not the log could be written, in the same csv format the tool reads
+*/
+bool writeLog(const std::vector<locationEntry> &trace, std::string filename)
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if(!file)
+        return false;
+
+    for(auto& entry : trace)
+        fprintf(file, "%.3f,%.7f,%.7f,%.2f,%.7f,%.7f,%.2f\n", entry.timestamp, entry.navLat, entry.navLon, entry.navAlt,
+                entry.gpsLat, entry.gpsLon, entry.gpsAlt);
+    return fclose(file) == 0;
+}
+
+/*
+*   Input: Approximate size of the log in megabytes and name of the file to write
+*   Output: Whether or not a user log in the same csv format the tool reads could be written
+*   Description: Writes a deterministic random walk so repeated runs parse identical data, without ever holding the
+*                whole log in memory
+*/
+bool writeSyntheticLog(size_t megabytes, std::string filename)
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if(!file)
+        return false;
+
+    syntheticRandom random(1);
+    double step = 0.00001;
+
+    double lat = BENCH_ORIGIN_LAT, lon = BENCH_ORIGIN_LON;
+    size_t written = 0;
+    for(long i = 0; written < megabytes << 20; i++)
+    {
+        lat += random.uniform(-step, step);
+        lon += random.uniform(-step, step);
+        int n = fprintf(file, "%.3f,%.7f,%.7f,%.2f,%.7f,%.7f,%.2f\n", i * 0.1, lat, lon, 250.0 + random.uniform(-step, step),
+                        lat + random.uniform(-step, step), lon + random.uniform(-step, step), 250.0 + random.uniform(-step, step));
+        if(n < 0)
+        {
+            fclose(file);
+            return false;
+        }
+        written += n;
+    }
+    return fclose(file) == 0;
+}
+
+#endif
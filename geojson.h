@@ -0,0 +1,219 @@
+#ifndef GEOJSON_SRC
+#define GEOJSON_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "data.h"
+#include "trace.h"
+#include "writer.h"
+#include "profile.h"
+
+// How results are written, picked with --format
+enum outputFormat {
+    FORMAT_GEOJSON,     // One FeatureCollection document per file
+    FORMAT_NDJSON,      // One feature per line, no enclosing collection
+    FORMAT_NDJSON_GZ,   // Same as FORMAT_NDJSON, gzip compressed
+    FORMAT_BINARY       // Occupancy results in the binary format of results.h, paths are still written as GeoJSON
+};
+
+/*
+*   Input: Name of a format (geojson, ndjson, ndjson.gz or binary), variable to hold the format
+*   Output: Whether or not the name was recognised
+*/
+inline bool parseFormat(const std::string &name, outputFormat &format)
+{
+    if(name == "geojson")
+        format = FORMAT_GEOJSON;
+    else if(name == "ndjson")
+        format = FORMAT_NDJSON;
+    else if(name == "ndjson.gz")
+        format = FORMAT_NDJSON_GZ;
+    else if(name == "binary")
+        format = FORMAT_BINARY;
+    else
+        return false;
+    return true;
+}
+
+/*
+*   Input: Format
+*   Output: File extension for GeoJSON output in that format
+*/
+inline const char* geojsonExtension(outputFormat format)
+{
+    if(format == FORMAT_NDJSON)
+        return ".ndjson";
+    if(format == FORMAT_NDJSON_GZ)
+        return ".ndjson.gz";
+    return ".geojson";
+}
+
+// Formats GeoJSON through a bufferedWriter, features are framed as a FeatureCollection or one per line depending on
+// the format
+class geojsonWriter : public bufferedWriter
+{
+    public:
+        geojsonWriter(const std::string &filename, outputFormat format = FORMAT_GEOJSON);
+        void coordinate(double lon, double lat);
+        void beginCollection();
+        void beginFeature();
+        void endFeature();
+        void endCollection();
+
+    private:
+        bool lines;
+        bool firstFeature = true;
+};
+
+/*
+*   Input: Name of the file to write and the format to write it in
+*   Output: Writer for that file, check isOpen() before use
+*/
+geojsonWriter::geojsonWriter(const std::string &filename, outputFormat format)
+    : bufferedWriter(filename, format == FORMAT_NDJSON_GZ)
+{
+    lines = format == FORMAT_NDJSON || format == FORMAT_NDJSON_GZ;
+}
+
+/*
+*   Input: Longitude and latitude
+*   Output: Nothing
+*   Description: Writes a GeoJSON position, [lon, lat]
+*/
+inline void geojsonWriter::coordinate(double lon, double lat)
+{
+    reserve(2 * WRITER_NUMBER + 4);
+    buffer[used++] = '[';
+    number(lon);
+    buffer[used++] = ',';
+    buffer[used++] = ' ';
+    number(lat);
+    buffer[used++] = ']';
+}
+
+// Every feature is written between beginFeature() and endFeature(), these add whatever separates features in the format
+inline void geojsonWriter::beginCollection()
+{
+    if(!lines)
+        text("{\"type\": \"FeatureCollection\", \"features\": [");
+}
+
+inline void geojsonWriter::beginFeature()
+{
+    if(!lines && !firstFeature)
+        text(",");
+    firstFeature = false;
+}
+
+inline void geojsonWriter::endFeature()
+{
+    if(lines)
+        text("\n");
+}
+
+inline void geojsonWriter::endCollection()
+{
+    if(!lines)
+        text("] }");
+}
+
+/*
+ *  Syntax for geojson file is as follows
+ * {
+ *  "type": "FeatureCollection",
+ *  "features": [
+ *      {
+ *          "type": "Feature",
+ *          "geometry": {
+ *              "type": "Polygon",
+ *              "coordinates": [
+ *                  [[lon1, lat1], [lon2, lat2]...]
+ *              ]
+ *          },
+ *          "properties": {
+ *              "stroke": "#color"
+ *          }
+ *      }, ...
+ *  ]
+ * }
+*/
+void outputJson(const buildingTable &buildings, const std::vector<char> &entered, std::string filename, outputFormat format = FORMAT_GEOJSON){
+    PROFILE_SCOPE(PROFILE_OUTPUT);
+
+    // Every feature is a building which has a set of coordinates that outline it, written as soon as it is formatted
+    geojsonWriter myFile(filename, format);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    myFile.beginCollection();
+    for(size_t i = 0; i < buildings.size(); i++)
+    {
+        uint32_t count = buildings.vertexCount(i);
+        if(count <= 2)
+            continue;
+
+        myFile.beginFeature();
+        myFile.text("{\"type\": \"Feature\", \"geometry\": { \"type\": \"Polygon\", \"coordinates\":  [[");
+        const osmium::Location *outline = buildings.outline(i);
+        for(uint32_t j = 0; j < count; j++)
+        {
+            if(j != 0)
+                myFile.text(", ");
+            myFile.coordinate(outline[j].lon(), outline[j].lat());
+        }
+        myFile.text("]] }, \"properties\": {\"stroke\":\" ");
+        myFile.text(entered[i] ? "#16e333" : "#449186");
+        myFile.text("\" } }");
+        myFile.endFeature();
+    }
+    myFile.endCollection();
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+void outputJson(const userTrace &user, std::string filename, outputFormat format = FORMAT_GEOJSON)
+{
+    PROFILE_SCOPE(PROFILE_OUTPUT);
+    std::cout << "Outputting user location data to " << filename << std::endl;
+
+    geojsonWriter myFile(filename, format);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    // One line string for the navisens path and one for the gps path, read straight out of the trace columns
+    const double *lon[2] = {user.navLon(), user.gpsLon()};
+    const double *lat[2] = {user.navLat(), user.gpsLat()};
+    const char *stroke[2] = {"#d11414", "#1423d1"};
+
+    myFile.beginCollection();
+    for(int i = 0; i < 2; i++)
+    {
+        myFile.beginFeature();
+        myFile.text("{\"type\": \"Feature\", \"geometry\": { \"type\": \"LineString\", \"coordinates\":  [");
+        for(size_t j = 0; j < user.size(); j++)
+        {
+            if(j != 0)
+                myFile.text(", ");
+            myFile.coordinate(lon[i][j], lat[i][j]);
+        }
+        myFile.text("] }, \"properties\": {\"stroke\":\" ");
+        myFile.text(stroke[i]);
+        myFile.text("\"} }");
+        myFile.endFeature();
+    }
+    myFile.endCollection();
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+#endif
@@ -2,122 +2,204 @@
 #define HANDLERS_SRC
 
 #include "data.h"
+#include "tiles.h"
+#include "profile.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
 
 #include <osmium/osm/types.hpp>
 #include <osmium/geom/tile.hpp>
 #include <osmium/relations/relations_manager.hpp>
 
-// Handler for osmium reader that gathers relevant data for all nodes
+// Highway classes kept by default, the roads and paths a pedestrian can be on
+#define HIGHWAY_CLASSES "residential,living_street,unclassified,service,tertiary,secondary,primary,trunk,pedestrian,footway,path,steps,cycleway,track"
+
+/*
+*   Input: Comma separated list
+*   Output: Every non empty entry of the list, sorted and without duplicates
+*/
+inline std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> entries;
+    size_t start = 0;
+    while(start <= list.size()){
+        size_t comma = list.find(',', start);
+        if(comma == std::string::npos)
+            comma = list.size();
+        if(comma > start)
+            entries.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    sort( entries.begin(), entries.end() );
+    entries.erase( unique( entries.begin(), entries.end() ), entries.end() );
+    return entries;
+}
+
+// Handler for osmium reader that gathers the location of every node inside the users tiles
 class nodeHandler : public osmium::handler::Handler {
 
     public:
-        
+        nodeHandler(const tileFilter &filter) : filter(filter) {}
+
         void node(const osmium::Node& node){
-            nodes.push_back(std::make_pair(node.location(), node.id()));
+            PROFILE_COUNT(PROFILE_OSM_NODES, 1);
+            total++;
+            if(filter.contains(node.location()))
+                nodes.push_back(std::make_pair(node.id(), node.location()));
         }
-        std::vector<std::pair<osmium::Location, int>> getNodes(){
+        std::vector<std::pair<osmium::object_id_type, osmium::Location>>& getNodes(){
             return nodes;
         }
+        size_t getTotal(){
+            return total;
+        }
     private:
-        std::vector<std::pair<osmium::Location, int>> nodes;
+        const tileFilter &filter;
+        std::vector<std::pair<osmium::object_id_type, osmium::Location>> nodes;
+        size_t total = 0;
+
+};
 
+// Handler for osmium reader that gathers the location of a given set of nodes, wherever they are
+class nodeIdHandler : public osmium::handler::Handler {
+
+    public:
+        nodeIdHandler(const std::vector<osmium::object_id_type> &ids) : ids(ids) {}
+
+        void node(const osmium::Node& node){
+            PROFILE_COUNT(PROFILE_OSM_NODES, 1);
+            if(std::binary_search(ids.begin(), ids.end(), node.id()))
+                nodes.push_back(std::make_pair(node.id(), node.location()));
+        }
+        std::vector<std::pair<osmium::object_id_type, osmium::Location>>& getNodes(){
+            return nodes;
+        }
+    private:
+        const std::vector<osmium::object_id_type> &ids;   // Ascending
+        std::vector<std::pair<osmium::object_id_type, osmium::Location>> nodes;
 };
 
-// Handler for osmium reader that gathers all buildings and stores their information in a custom struct
+// Handler for osmium reader that gathers all buildings and stores their information in a buildingTable
+// Buildings mapped as ways only get their node ids here, Map resolves them into vertices once every node is known
 class buildingHandler : public osmium::handler::Handler {
 
-    void outputBuildings(const osmium::Node& node, std::vector<building> &buildings){
+    void readTags(const osmium::TagList& tags){
+        uint32_t street = 0, houseNumber = 0, postalCode = 0, type = 0, height = 0, name = 0;
+        for(const osmium::Tag& tag : tags) {
+            if(!std::strncmp(tag.key(), "addr:street", 11))
+                street = pool.intern(tag.value());
+            else if (!std::strncmp(tag.key(), "addr:housenumber", 16))
+                houseNumber = pool.intern(tag.value());
+            else if (!std::strncmp(tag.key(), "addr:postcode", 13))
+                postalCode = pool.intern(tag.value());
+            else if (!std::strncmp(tag.key(), "building", 8))
+                type = pool.intern(tag.value());
+            else if (!std::strncmp(tag.key(), "height", 6))
+                height = pool.intern(tag.value());
+            else if(!std::strncmp(tag.key(), "name", 4))
+                name = pool.intern(tag.value());
+        }
+        buildings.type.push_back(type);
+        buildings.street.push_back(street);
+        buildings.houseNumber.push_back(houseNumber);
+        buildings.postalCode.push_back(postalCode);
+        buildings.height.push_back(height);
+        buildings.name.push_back(name);
+    }
+
+    void outputBuildings(const osmium::Node& node){
         const osmium::TagList& tags = node.tags();
         if (tags.has_key("building")) {
-           building tempBuilding;
-           tempBuilding.location = node.location();
-           for(const osmium::Tag& tag : tags) {
-                if(!std::strncmp(tag.key(), "addr:street", 11))
-                    tempBuilding.street = tag.value();
-                else if (!std::strncmp(tag.key(), "addr:housenumber", 16))
-                    tempBuilding.houseNumber = tag.value();
-                else if (!std::strncmp(tag.key(), "addr:postcode", 13))
-                    tempBuilding.postalCode = tag.value();
-                else if (!std::strncmp(tag.key(), "building", 8))
-                    tempBuilding.type = tag.value();
-                else if (!std::strncmp(tag.key(), "height", 6))
-                    tempBuilding.height = tag.value();
-                else if(!std::strncmp(tag.key(), "name", 4))
-                    tempBuilding.name = tag.value();
-           }
-           buildings.push_back(tempBuilding);
+            buildings.id.push_back(node.id());
+            buildings.location.push_back(node.location());
+            buildings.vertexOffset.push_back(buildings.vertices.size());
+            nodeOffset.push_back(nodeIds.size());
+            readTags(tags);
         }
     }
 
-    void outputBigBuildings(const osmium::Way& way, std::vector<building> &buildings){
+    void outputBigBuildings(const osmium::Way& way){
         const osmium::TagList& tags = way.tags();
         if(tags.has_key("building")){
-            building tempBuilding;
-
             for(auto& node : way.nodes())
-                tempBuilding.nodeIds.push_back(node.ref());
-            
-            for(const osmium::Tag& tag : tags) {
-                if(!std::strncmp(tag.key(), "addr:street", 11))
-                    tempBuilding.street = tag.value();
-                else if (!std::strncmp(tag.key(), "addr:housenumber", 16))
-                    tempBuilding.houseNumber = tag.value();
-                else if (!std::strncmp(tag.key(), "addr:postcode", 13))
-                    tempBuilding.postalCode = tag.value();
-                else if (!std::strncmp(tag.key(), "building", 8))
-                    tempBuilding.type = tag.value();
-                else if (!std::strncmp(tag.key(), "height", 6))
-                    tempBuilding.height = tag.value();
-                else if(!std::strncmp(tag.key(), "name", 4))
-                    tempBuilding.name = tag.value();
-            }
-           buildings.push_back(tempBuilding);
+                nodeIds.push_back(node.ref());
+
+            buildings.id.push_back(way.id());
+            buildings.location.push_back(osmium::Location());
+            buildings.vertexOffset.push_back(buildings.vertices.size());
+            nodeOffset.push_back(nodeIds.size());
+            readTags(tags);
         }
     }
 
     public:
+        buildingHandler(stringPool &pool) : pool(pool) {}
+
         void node(const osmium::Node& node){
-            outputBuildings(node, buildings);
+            outputBuildings(node);
         }
         void way(const osmium::Way& way){
-            outputBigBuildings(way, buildings);
+            PROFILE_COUNT(PROFILE_OSM_WAYS, 1);
+            outputBigBuildings(way);
         }
-        std::vector<building> getBuildings(){
+        buildingTable& getBuildings(){
             return buildings;
         }
+        // Nodes of building i are getNodeIds()[getNodeOffsets()[i]] up to getNodeIds()[getNodeOffsets()[i + 1]]
+        std::vector<osmium::object_id_type>& getNodeIds(){
+            return nodeIds;
+        }
+        std::vector<size_t>& getNodeOffsets(){
+            return nodeOffset;
+        }
     private:
-        std::vector<building> buildings;
+        stringPool &pool;
+        buildingTable buildings;
+        std::vector<osmium::object_id_type> nodeIds;
+        std::vector<size_t> nodeOffset{0};
 };
 
-// Handler for osmium reader that gathers all highways and stores their information in a custom struct
+// Handler for osmium reader that gathers every highway of the wanted classes and stores their information in a highwayTable
 class highwayHandler : public osmium::handler::Handler {
     void outputWays(const osmium::Way& way) {
         const osmium::TagList& tags = way.tags();
         if(tags.has_key("highway")){
-            highway tempHighway;
-            for(auto& node : way.nodes())
-                tempHighway.nodeIds.push_back(node.ref());
-
+            const char *type = "";
+            const char *name = "";
             for(const osmium::Tag& tag : tags) {
                 if(!std::strncmp(tag.key(), "highway", 7))
-                    tempHighway.type = tag.value();
+                    type = tag.value();
                 if(!std::strncmp(tag.key(), "name", 4))
-                    tempHighway.name = tag.value();
+                    name = tag.value();
+            }
+            if(classes.count(type)){
+                highways.id.push_back(way.id());
+                for(auto& node : way.nodes())
+                    highways.nodeIds.push_back(node.ref());
+                highways.nodeOffset.push_back(highways.nodeIds.size());
+                highways.type.push_back(pool.intern(type));
+                highways.name.push_back(pool.intern(name));
             }
-            if(tempHighway.type == "residential")
-                highways.push_back(tempHighway);
-        
         }
     }
     public:
+        highwayHandler(stringPool &pool, const std::vector<std::string> &highwayClasses) : pool(pool),
+            classes(highwayClasses.begin(), highwayClasses.end()) {}
+
         void way(const osmium::Way& way){
             outputWays(way);
         }
-        std::vector<highway> getHighways(){
+        highwayTable& getHighways(){
             return highways;
         }
     private:
-        std::vector<highway> highways;
+        stringPool &pool;
+        std::unordered_set<std::string> classes;
+        highwayTable highways;
 };
 
 #endif
\ No newline at end of file
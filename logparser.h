@@ -0,0 +1,306 @@
+#ifndef LOGPARSER_SRC
+#define LOGPARSER_SRC
+
+#include <vector>
+#include <string>
+#include <charconv>
+#include <algorithm>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "data.h"
+#include "threadpool.h"
+#include "profile.h"
+
+// Number of values on every line of a user log: Timestamp, Nav Lat/Lon/Alt, GPS Lat/Lon/Alt
+#define LOG_FIELDS 7
+
+// Number of bytes sampled from the start of a log to estimate how many lines it has
+#define LOG_SAMPLE_BYTES 65536
+
+// Logs smaller than this are always parsed on the calling thread
+#define LOG_PARALLEL_BYTES (16 << 20)
+
+// Read only memory mapping of an entire file, unmapped when it goes out of scope
+class mappedFile
+{
+    public:
+        mappedFile(const std::string &filename);
+        ~mappedFile();
+        mappedFile(const mappedFile&) = delete;
+        mappedFile& operator=(const mappedFile&) = delete;
+        bool isOpen() const;
+        const char* data() const;
+        size_t size() const;
+
+    private:
+        const char *bytes = nullptr;
+        size_t length = 0;
+        bool open = false;
+};
+
+/*
+*   Input: Name of the file to map
+*   Output: Mapping of the whole file, isOpen() is false if the file could not be opened
+*/
+mappedFile::mappedFile(const std::string &filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+
+    struct stat info;
+    if(fstat(fd, &info) == 0){
+        length = info.st_size;
+        open = true;
+
+        // An empty file is valid but cannot be mapped
+        if(length > 0){
+            void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping == MAP_FAILED){
+                length = 0;
+                open = false;
+            }else{
+                bytes = static_cast<const char*>(mapping);
+                madvise(mapping, length, MADV_SEQUENTIAL);
+            }
+        }
+    }
+    ::close(fd);
+}
+
+mappedFile::~mappedFile()
+{
+    if(bytes)
+        munmap(const_cast<char*>(bytes), length);
+}
+
+bool mappedFile::isOpen() const
+{
+    return open;
+}
+
+const char* mappedFile::data() const
+{
+    return bytes;
+}
+
+size_t mappedFile::size() const
+{
+    return length;
+}
+
+/*
+*   Input: Position of a field within a line and the end of the line
+*   Output: Whether or not a number could be read, p is moved past the field and its delimiter
+*   Description: Converts the field in place without copying it. Like stod, leading whitespace, an opening quote or a
+*                plus sign are accepted and anything after the number up to the next comma is ignored
+*/
+inline bool parseField(const char *&p, const char *end, double &value)
+{
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '"'))
+        p++;
+    if(p < end && *p == '+')
+        p++;
+
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if(result.ec != std::errc())
+        return false;
+
+    const char *comma = static_cast<const char*>(memchr(result.ptr, ',', end - result.ptr));
+    p = comma ? comma + 1 : end;
+    return true;
+}
+
+/*
+*   Input: Start and end of a single line from a csv file (without the newline)
+*   Output: Whether or not the line held a complete entry, entry is populated with its values if it did
+*/
+inline bool parseLine(const char *p, const char *end, locationEntry &entry)
+{
+    double values[LOG_FIELDS];
+
+    for(int i = 0; i < LOG_FIELDS; i++){
+        // Make sure no data is missing from the line
+        if(p >= end || !parseField(p, end, values[i]))
+            return false;
+    }
+
+    entry.timestamp = values[0];
+    entry.navLat = values[1];
+    entry.navLon = values[2];
+    entry.navAlt = values[3];
+    entry.gpsLat = values[4];
+    entry.gpsLon = values[5];
+    entry.gpsAlt = values[6];
+    return true;
+}
+
+/*
+*   Input: Start and end of a block of csv lines
+*   Output: Rough number of lines in the block
+*   Description: Counts the newlines in the first LOG_SAMPLE_BYTES and scales up to the size of the block
+*/
+inline size_t estimateLines(const char *begin, const char *end)
+{
+    size_t size = end - begin;
+    size_t sample = std::min<size_t>(size, LOG_SAMPLE_BYTES);
+
+    size_t lines = 0;
+    const char *p = begin;
+    while((p = static_cast<const char*>(memchr(p, '\n', begin + sample - p))) != nullptr){
+        lines++;
+        p++;
+    }
+
+    if(lines == 0)
+        return 1;
+    return size / sample * lines + lines;
+}
+
+/*
+*   Input: Start and end of a block of csv lines and vector to hold each entry
+*   Output: Number of entries appended to the vector
+*   Description: Splits the block into lines with memchr (which glibc vectorizes) and converts every line in place.
+*                Lines with missing or malformed values are skipped
+*/
+size_t parseLog(const char *begin, const char *end, std::vector<locationEntry> &data)
+{
+    PROFILE_SCOPE(PROFILE_PARSE_LOG);
+    size_t before = data.size();
+    data.reserve(before + estimateLines(begin, end));
+
+    locationEntry entry;
+    const char *p = begin;
+    while(p < end)
+    {
+        const char *newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char *lineEnd = newline ? newline : end;
+
+        // Ignore windows line endings
+        const char *valuesEnd = lineEnd;
+        if(valuesEnd > p && valuesEnd[-1] == '\r')
+            valuesEnd--;
+
+        // Add a new entry to the struct vector that holds all the values from the current line of the csv file
+        if(parseLine(p, valuesEnd, entry))
+            data.push_back(entry);
+
+        p = lineEnd + 1;
+    }
+
+    PROFILE_COUNT(PROFILE_CSV_LINES, data.size() - before);
+    return data.size() - before;
+}
+
+/*
+*   Input: Entries and the index of the first one read from the log
+*   Output: Nothing
+*   Description: Sorts the entries read from the log by timestamp, only if they were not already in order. Stable, so
+*                entries with the same timestamp keep their file order and every way of reading a log gives the same result
+*/
+void sortByTimestamp(std::vector<locationEntry> &data, size_t start)
+{
+    auto byTimestamp = [](const locationEntry &a, const locationEntry &b){ return a.timestamp < b.timestamp; };
+    if(!std::is_sorted(data.begin() + start, data.end(), byTimestamp))
+        std::stable_sort(data.begin() + start, data.end(), byTimestamp);
+}
+
+/*
+*   Input: Filename and vector to hold each entry
+*   Output: Vector that has been populated with the data from the provided csv files, sorted by timestamp
+*   Description: Memory maps the file (assuming it exists) and parses every line straight into the struct vector
+*/
+void tokenizeLog(std::vector<locationEntry> &data, std::string filename)
+{
+    mappedFile file(filename);
+
+    if (!file.isOpen() || file.size() == 0) return;
+
+    size_t start = data.size();
+    parseLog(file.data(), file.data() + file.size(), data);
+    sortByTimestamp(data, start);
+}
+
+/*
+*   Input: Start and end of a block of csv lines and the number of pieces to split it into
+*   Output: Start of every piece followed by the end of the block
+*   Description: Every split point is moved forward to just after the next newline so no line is cut in two
+*/
+std::vector<const char*> splitLines(const char *begin, const char *end, size_t pieces)
+{
+    std::vector<const char*> bounds(1, begin);
+    size_t size = end - begin;
+
+    for(size_t i = 1; i < pieces; i++)
+    {
+        const char *p = std::max(begin + size / pieces * i, bounds.back());
+        const char *newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(!newline)
+            break;
+        if(newline + 1 > bounds.back())
+            bounds.push_back(newline + 1);
+    }
+    bounds.push_back(end);
+
+    return bounds;
+}
+
+/*
+*   Input: Filename, vector to hold each entry and number of threads to parse with
+*   Output: Whether or not the file could be opened, vector that has been populated with the data from the provided csv files
+*   Description: Splits the mapped file at newline aligned offsets and parses the pieces concurrently into their own
+*                buffers. The buffers are copied into data in file order, also in parallel, and sorted by timestamp
+*                only if the log was not already in order. Small logs and single threaded runs are parsed in one piece
+*                and sorted the same way, so the result never depends on the number of threads
+*/
+bool tokenizeLog(std::vector<locationEntry> &data, std::string filename, int workers)
+{
+    mappedFile file(filename);
+
+    if (!file.isOpen() || file.size() == 0) return false;
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    if(workers == 1 || file.size() < LOG_PARALLEL_BYTES){
+        size_t start = data.size();
+        parseLog(begin, end, data);
+        sortByTimestamp(data, start);
+        return true;
+    }
+
+    threadPool pool(workers);
+
+    // Several pieces per thread so one slow piece does not hold up the rest
+    std::vector<const char*> bounds = splitLines(begin, end, pool.size() * 4);
+    std::vector<std::vector<locationEntry>> pieces(bounds.size() - 1);
+
+    for(size_t i = 0; i < pieces.size(); i++)
+        pool.submit([&pieces, &bounds, i]{ parseLog(bounds[i], bounds[i + 1], pieces[i]); });
+    pool.wait();
+
+    // Stitch the pieces together in file order
+    size_t start = data.size();
+    std::vector<size_t> offsets;
+    size_t total = start;
+    for(auto& piece : pieces){
+        offsets.push_back(total);
+        total += piece.size();
+    }
+    data.resize(total);
+
+    for(size_t i = 0; i < pieces.size(); i++)
+        pool.submit([&pieces, &offsets, &data, i]{
+            std::copy(pieces[i].begin(), pieces[i].end(), data.begin() + offsets[i]);
+            std::vector<locationEntry>().swap(pieces[i]);
+        });
+    pool.wait();
+
+    sortByTimestamp(data, start);
+    return true;
+}
+
+#endif
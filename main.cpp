@@ -12,205 +12,46 @@
 #include <thread>
 #include <math.h>
 #include <cmath>
+#include <memory>
+#include <atomic>
+#include <mutex>
 
 #include "map.h"
 #include "data.h"
+#include "threadpool.h"
+#include "logparser.h"
+#include "stream.h"
+#include "geojson.h"
+#include "results.h"
+#include "playback.h"
+#include "queryworker.h"
+#include "mapmatch.h"
+#include "visits.h"
+#include "drift.h"
+#include "occupancy.h"
 
 #include <osmium/osm/types.hpp>
-#include <osmium/io/xml_input.hpp>
+
+// Built with -DHEADLESS (make batch) the playback window is left out entirely and every run is a batch run
+#ifndef HEADLESS
 #include <SFML/Graphics.hpp>
 #include <SFML/OpenGL.hpp>
-#include <boost/tokenizer.hpp>
-
-void outputJson(std::vector<building> &buildings, std::string filename){
-
-    std::ofstream myFile;
-    
-    // Every entry is a new building which has a set of coordinates that outline it
-    std::vector<featurePolygon> featureCollection;
-
-   for(auto& building : buildings)
-   {
-       if(building.nodeLocations.size() > 2)
-       {
-           featurePolygon newFeature;
-           newFeature.type = "\"Polygon\"";
-           newFeature.entered = building.entered;
-           for(auto& node : building.nodeLocations)
-           {
-                // Coordinate for this node
-                std::string coord = "[" + std::to_string(node.lon()) + ", " + std::to_string(node.lat()) + "]";
-
-                newFeature.coordinates.push_back(coord);
-           }
-           featureCollection.push_back(newFeature);
-       }
-   }
-
-/*
- *  Syntax for geojson file is as follows
- * {
- *  "type": "FeatureCollection",
- *  "features": [
- *      {
- *          "type": "Feature",
- *          "geometry": {
- *              "type": "Polygon",
- *              "coordinates": [
- *                  [[lon1, lat1], [lon2, lat2]...]
- *              ]
- *          },
- *          "properties": {
- *              "stroke": "#color"
- *          }
- *      }, ...
- *  ]
- * }
-*/
-
-   myFile.open(filename);
-   myFile << "{\"type\": \"FeatureCollection\", \"features\": [";
-   for(int i = 0; i < featureCollection.size(); i++)
-   {
-        myFile << "{\"type\": \"Feature\", \"geometry\": { \"type\": ";
-        myFile << featureCollection[i].type + ", \"coordinates\":  [[";
-        for(int j = 0; j < featureCollection[i].coordinates.size(); j++){
-            myFile << featureCollection[i].coordinates[j];
-            if( j != featureCollection[i].coordinates.size() - 1)
-                myFile << ", ";
-        }
-        myFile << "]] }, \"properties\": {";
-        myFile << "\"stroke\":\" ";
-        if(featureCollection[i].entered)
-            myFile << "#16e333";
-        else
-            myFile << "#449186";
-        myFile << "\" ";
-        myFile << "} }";
-        if(i != featureCollection.size() - 1)
-            myFile << ",";
-   }
-   myFile << "] }";
-   myFile.close();
-   
-}
-
-void outputJson(std::vector<locationEntry> &user, std::string filename)
-{
-    std::ofstream myFile;
-    std::cout << "Outputting user location data to " << filename << std::endl;
-    std::vector<featureLineString> featureCollection;
-
-    featureLineString newFeature1, newFeature2;
-    newFeature1.type = "\"LineString\"";
-    newFeature2.type = "\"LineString\"";
-    newFeature1.user = "nav";
-    newFeature2.user = "gps";
-    for(auto& location : user)
-    {
-        std::string navCoord = "[" + std::to_string(location.navLon) + ", " + std::to_string(location.navLat) + "]";
-        std::string gpsCoord = "[" + std::to_string(location.gpsLon) + ", " + std::to_string(location.gpsLat) + "]";
-        newFeature1.coordinates.push_back(navCoord);
-        newFeature2.coordinates.push_back(gpsCoord);
-    }
-
-    featureCollection.push_back(newFeature1);
-    featureCollection.push_back(newFeature2);
-
-    myFile.open(filename);
-    myFile << "{\"type\": \"FeatureCollection\", \"features\": [";
-    for(int i = 0; i < featureCollection.size(); i++)
-    {
-        myFile << "{\"type\": \"Feature\", \"geometry\": { \"type\": ";
-        myFile << featureCollection[i].type + ", \"coordinates\":  [";
-        for(int j = 0; j < featureCollection[i].coordinates.size(); j++){
-                myFile << featureCollection[i].coordinates[j];
-                if( j != featureCollection[i].coordinates.size() - 1)
-                    myFile << ", ";
-        }
-        myFile << "] }, \"properties\": {";
-        myFile << "\"stroke\":\" ";
-        if(i == 0)
-            myFile << "#d11414";
-        else
-            myFile << "#1423d1";
-        myFile << "\"";
-        myFile << "} }";
-        if(i != featureCollection.size() - 1)
-            myFile << ",";
-    }
-    myFile << "] }";
-   myFile.close();
-}
+#endif
 
 /*
-*   Input: locationEntry vector and name of osm file
+*   Input: Trace of every user, name of osm file, comma separated highway classes to keep and zoom of the tiles to load
 *   Output: Map object that contains the id of every node that exists in the same osm tile as one of the coordinates in data
 *   Description: createMap creates a map object that can be queried with a location to return the id of every node that exists
 *                within the same osm tile
 */
-Map createMap(std::vector<std::vector<locationEntry>> &data, std::string osmFile){
+Map createMap(std::vector<userTrace> &data, std::string osmFile, std::string highwayClasses, uint32_t zoom){
 
-    Map map(data, osmFile);
+    Map map(data, osmFile, true, highwayClasses, zoom);
 
     return map;
 }
 
-/*
-*   Input: Tokenized string vector of a single line from a csv file
-*   Output: A struct populated with each value from the csv file line
-*   Description: Takes a tokenized string from a csv files, pulls the values out one by one and puts them into a temporary struct
-*                that is returned
-*/
-locationEntry newEntry(std::vector<std::string> &vec)
-{
-    // Temporary object to hold the extracted values
-    locationEntry temp;
-
-    temp.timestamp = stod(vec[0]);
-    temp.navLat = stod(vec[1]);
-    temp.navLon = stod(vec[2]);
-    temp.navAlt = stod(vec[3]);
-    temp.gpsLat = stod(vec[4]);
-    temp.gpsLon = stod(vec[5]);
-    temp.gpsAlt = stod(vec[6]);
-
-    // Return the temp object so that it can be added to the main vector
-    return temp;
-}
-
-/*
-*   Input: Filename and vector to hold each entry
-*   Output: Vector that has been populated with the data from the provided csv files
-*   Description: Parses the data from each line of the provided file (assuming it exists) and stores them in a struct vector
-*/
-void tokenizeLog(std::vector<locationEntry> &data, std::string filename)
-{
-    using namespace std;
-    using namespace boost;
-
-    ifstream in(filename.c_str());
-
-    if (!in.is_open()) return;
-
-    typedef tokenizer< escaped_list_separator<char> > Tokenizer;
-
-    vector< string > vec;
-    string line;
-
-    while (getline(in,line))
-    {
-        Tokenizer tok(line);
-        vec.assign(tok.begin(),tok.end());
-
-        // Make sure no data is missing from the line
-        if (vec.size() < 7) continue;
-        
-        // Add a new entry to the struct vector that holds all the values from the current line of the csv file
-        data.push_back(newEntry(vec));
-    }
-}
-
+#ifndef HEADLESS
 /*
 *   Input: Key press event
 *   Output: Number denoting which button was pressed
@@ -228,6 +69,10 @@ int keyPressed(sf::Event event)
         return 3;
     else if(event.key.code == sf::Keyboard::U)
         return 4;
+    else if(event.key.code == sf::Keyboard::Right)
+        return 5;
+    else if(event.key.code == sf::Keyboard::Left)
+        return 6;
 
     return 0;
 }
@@ -243,142 +88,53 @@ void displayLocationData(locationEntry loc)
     std::cout << "Navisense Latitude: " << loc.navLat << " | GPS Latitude: " << loc.gpsLat << std::endl;
     std::cout << "Navisense Longitude: " << loc.navLon << " | GPS Longitude: " << loc.gpsLon << std::endl;
     std::cout << "Navisense Altitude: " << loc.navAlt << " | GPS Altitude: " << loc.gpsAlt << std::endl;
+    std::cout << "Navisense to GPS distance: " << haversine(loc.navLat, loc.navLon, loc.gpsLat, loc.gpsLon) << " m" << std::endl;
     
 }
 
 /*
-* Input: two pairs of latitudes/longitudes
-* Output: Difference between the two points
-* Description: Calculates the angle between two points on a plane
-*/
-double angle2D(double lat1, double lon1, double lat2, double lon2)
-{
-    double theta1 = atan2(lat1, lon1);
-    double theta2 = atan2(lat2, lon2);
-    double dtheta = theta2 - theta1;
-    while(dtheta > M_PI)
-        dtheta -= (M_PI * 2);
-    while(dtheta <  -M_PI)
-        dtheta += (M_PI * 2);
-    return(dtheta);
-}
-
-/*
-* Input: Building vecotr, user latitude, user longitude
-* Output: none:
-* Checks each building for whether or not it contains the users location and if it does, it marks that building
-*/
-void pointWithinBuilding(std::vector<building> &buildings, double lat, double lon)
-{
-    int counter = 0;
-    for(auto& building : buildings)
-    {
-        if(building.nodeLocations.size() < 3 || building.entered == true)
-            continue;
-        
-        int i;
-        double angle=0;
-        int n = building.nodeLocations.size();
-        double p1lat, p1lon;
-        double p2lat, p2lon;
-
-        for (i=0;i<n;i++) {
-            p1lat = building.nodeLocations[i].lat() - lat;
-            p1lon = building.nodeLocations[i].lon() - lon;
-            p2lat = building.nodeLocations[(i+1)%n].lat() - lat;
-            p2lon = building.nodeLocations[(i+1)%n].lon() - lon;
-            angle += angle2D(p1lat,p1lon,p2lat,p2lon);
-        }
-        if (abs(angle) >= M_PI)
-            building.entered = true;    
-    }
-}
-
-/*
-* Input: Map object, User locaitons, unique user identifier
-* Output: A GeoJSON file containing the buildings the user encounters as well as which ones are entered
-* Description: Takes in a users location data, their user number, and the buildings in order to calculate which buildings this specific user enters
+*   Input: Result of the map queries for one users new sample
+*   Output: Neatly formatted values for the sample along with what the map knows about its location
 */
-void getOccupiedBuildings(Map &map, std::vector<locationEntry> &user, int usernum)
+void displayLocationData(const queryResult &result)
 {
-    //Get a list of every building on the map
-    std::vector<building> buildings = map.getBuildings();
-    std::cout << "Checking " << buildings.size() << " buildings against " << user.size() << " locations for user " << usernum << std::endl;
-
-    for(auto& location : user)
-    {
-        pointWithinBuilding(buildings, location.navLat, location.navLon);
-    }
+    if(result.entry.timestamp == -1)
+        return;
 
-    std::string filename = "user";
-    filename.append(std::to_string(usernum));
-    filename.append("buildings.geojson");
-    outputJson(buildings, filename);
-}
-
-/*
-*   Input: locationEntry object vector and Map object
-*   Output: Neatly formatted values for each object in the vector including a list of node ids nearby
-*   Description: Used to print out the values of every locationEntry object in a vector
-*/
-void displayLocationData(std::vector<locationEntry> &loc, Map &map)
-{
     std::cout.precision(10);
-
-    for(int i = 0; i < loc.size(); i++)
-    {
-        osmium::Location userLocation(loc[i].navLon, loc[i].navLat);
-        
-        osmium::geom::Tile userTile(ZOOM, userLocation);
-        
-        // The id of every node within the same tile as the user
-        //std::vector<int> nodeIds = map.getIds(userLocation);
-
-        // Information on every building within the same tile as the user
-        std::vector<building> buildings = map.getBuildings(userLocation);
-        
-        // Information on every highway that the user will encounter
-        std::vector<highway> highways = map.getHighways(userLocation);
-        
-        if(loc[i].timestamp != -1)
-        {
-            std::cout << "Timestamp: " << loc[i].timestamp << std::endl;
-            std::cout << "Navisense Latitude: " << loc[i].navLat << " | GPS Latitude: " << loc[i].gpsLat << std::endl;
-            std::cout << "Navisense Longitude: " << loc[i].navLon << " | GPS Longitude: " << loc[i].gpsLon << std::endl;
-            std::cout << "Navisense Altitude: " << loc[i].navAlt << " | GPS Altitude: " << loc[i].gpsAlt << std::endl;
-            
-            std::cout << "Buildings: " << buildings.size() << " | " << "Highways: " << highways.size() << std::endl; 
-            std::cout << "Current tile: " << userTile.x << ", " << userTile.y << std::endl; 
-            
-        }
-    }
+    std::cout << "User: " << result.user + 1 << std::endl;
+    displayLocationData(result.entry);
+    std::cout << "Buildings: " << result.buildings << " | " << "Highways: " << result.highways << std::endl;
+    std::cout << "Current tile: " << result.tileZ << "/" << result.tileX << "/" << result.tileY << std::endl;
 }
 
 /*
-*   Input: Tokenized data from provided csv files
+*   Input: Trace of every user and Map object
 *   Output: Continuous real time data stream of Latitude/Longitude/Altitude values from both the GPS and Navisens
-*   Description: Once the csv files have been tokenized this function prints out the data values in real time 
-*                allowing for speed and directional changes 
+*   Description: Once the traces are loaded this function prints out the data values in real time allowing for speed and
+*                directional changes and jumps. Between window events the loop sleeps until the next sample is due.
+*                Map queries for new samples run on a query worker, this thread only hands over samples and prints results
 */
-void parseData(std::vector<std::vector<locationEntry>> &data, Map &map)
+void parseData(std::vector<userTrace> &data, Map &map)
 {
     std::cout << "Starting data stream" << std::endl;
-    bool play = false;      // Whether or not the data stream is currently being ran
-    bool forward = true;    // Which direction data stream is moving in. true = forward, false = backwards
-    bool update = false;    // Whether or not the "current" location entries have been updated
-    float speed = 1;        // Current speed of playback
 
-    locationEntry blank;
+    playbackClock clock;
+    playback player(data);
+    queryWorker worker(map);
 
-    std::vector<locationEntry>  current(data.size(), blank);
-    std::vector<std::vector<locationEntry>::iterator> it(data.size());
-    for(int i = 0; i < data.size(); i++)
-        it[i] = data[i].begin();
+    // Users whose latest sample still has to be handed to the worker, only the newest sample of a user is ever sent
+    std::vector<char> unsent(data.size(), false);
+    size_t unsentCount = 0;
+    auto markChanged = [&]{
+        for(auto& user : player.changed())
+        {
+            if(!unsent[user])
+                unsentCount++;
+            unsent[user] = true;
+        }
+    };
 
-    clock_t startTime;
-    clock_t sumTime = 0;//35000000;
-    double secondsPassed;
-    
     sf::RenderWindow window(sf::VideoMode(1, 1), "Location Data Parser");
     while (window.isOpen()) 
     {
@@ -403,114 +159,79 @@ void parseData(std::vector<std::vector<locationEntry>> &data, Map &map)
                             window.close();
                             break;
                         case 2:
-                            if(play)
+                            if(clock.playing())
                             {
                                 std::cout << "Pausing playback" << std::endl;
-
-                                // if you are moving forward then add the elapsed time to the total
-                                if(forward)
-                                    sumTime += (clock() - startTime) * speed;
-
-                                // otherwise subtract the elapsed time from the total
-                                else
-                                    sumTime -= (clock() - startTime) * speed;
+                                clock.pause();
                             }else
                             {
-                                // Start counting from now
                                 std::cout << "Resuming" << std::endl;
-                                startTime = clock();
+                                clock.play();
                             }
-                                
-                            play = !play;
                             break;
                         case 3:
-                            if(forward)
-                            {
-                                // If moving forwards, decrement the iterators by 2, once to reach the current value and again to move behind it
-                                std::cout << "Scanning backwards" << std::endl;
-                                for(int i = 0; i < it.size(); i++)
-                                    it[i] -= 2;
-                                if(play)
-                                    sumTime += (clock() - startTime) * speed;
-                            }else
-                            {
-                                // Otherwise increment the iterators by 2, once to reach the current value and again to move ahead of it
-                                std::cout << "Scanning forwards" << std::endl;
-                                for(int i = 0; i < it.size(); i++)
-                                    it[i] += 2;
-                                if(play)
-                                    sumTime -= (clock() - startTime) * speed;
-                            }
-                            if(play)
-                                startTime = clock();
-                            forward = !forward;
+                            std::cout << (clock.forward() ? "Scanning backwards" : "Scanning forwards") << std::endl;
+                            clock.reverse();
                             break;
                         case 4:
-                            if(play){
-                                if(forward)
-                                    sumTime += (clock() - startTime) * speed;
-                                else
-                                    sumTime -= (clock() - startTime) * speed;
-                                startTime = clock();
-                            }
                             // Speed moves cyclically from .5->1->2->.5
-                            if(speed == 2)
-                                speed = .5;
-                            else
-                                speed *= 2;
-                            std::cout << "Speed set to " << speed << "x speed" << std::endl;
+                            clock.setSpeed(clock.getSpeed() == 2 ? .5 : clock.getSpeed() * 2);
+                            std::cout << "Speed set to " << clock.getSpeed() << "x speed" << std::endl;
+                            break;
+                        case 5:
+                        case 6:
+                            clock.seek(clock.now() + (keyPressed(event) == 5 ? PLAYBACK_SKIP : -PLAYBACK_SKIP));
+                            std::cout << "Jumped to " << clock.now() << " seconds" << std::endl;
+                            if(player.seek(clock.now()))
+                                markChanged();
                             break;
                     }
 					break;
+                default:
+                    break;
             }
         }
 
-        // If playback is not paused
-        if(play)
+        // If the current sample of any user changed, hand the new samples to the worker
+        if(clock.playing() && player.seek(clock.now()))
+            markChanged();
+        for(size_t i = 0; i < unsent.size() && unsentCount > 0; i++)
         {
-            // If we are going forward
-            if(forward)
-            { 
-                // Total time plus the elapsed time since the last change
-                secondsPassed = (((clock() - startTime) * speed) + sumTime) / CLOCKS_PER_SEC;
-                for(int i = 0; i < current.size(); i++)
-                {
-                    // If the current time is equal to or greater than the next timestamp in ascending chronological order
-                    if(secondsPassed >= it[i][0].timestamp)
-                    {
-                        // Assign a new value to the current object and increment the iterator
-                        current[i] = it[i][0];
-                        it[i]++;
-                        update = true;
-                    }
-                }
-            // Otherwise we are moving backwards
-            }else
-            {
-                // Total time minus the elapsed time since the last change
-                secondsPassed = (sumTime - ((clock() - startTime) * speed)) / CLOCKS_PER_SEC;
-                for(int i = 0; i < current.size(); i++)
-                {
-                    // If the current time is less than or equal to the next timestamp in descending chronological order
-                    if(secondsPassed <= it[i][0].timestamp)
-                    {
-                        // Assign a new value to the current object and decrement the iterator
-                        current[i] = it[i][0];
-                        it[i]--;
-                        update = true;
-                    }
-                }
-            }
-
-            // If the current data vector has been updated, display the new data
-            if(update)
+            if(unsent[i] && worker.submit(i, player.current()[i]))
             {
-                displayLocationData(current, map);
-                update = false;
+                unsent[i] = false;
+                unsentCount--;
             }
         }
+
+        // Display whatever the worker has finished
+        queryResult result;
+        while(worker.poll(result))
+            displayLocationData(result);
+
+        // Sleep until the next sample is due, waking up regularly to keep handling window events and sooner while the
+        // worker still has results to hand back
+        std::chrono::steady_clock::duration wait = PLAYBACK_POLL;
+        if(unsentCount > 0 || worker.pending() > 0)
+            wait = std::chrono::milliseconds(1);
+        if(clock.playing())
+            wait = std::min<std::chrono::steady_clock::duration>(wait, clock.until(player.nextChange(clock.forward())));
+        std::this_thread::sleep_for(wait);
     }
 }
+#endif
+
+/*
+*   Input: Name and start of a phase of the run, list of the phases so far
+*   Output: Nothing
+*   Description: Records how long the phase took and prints it, so slow phases show up in the logs of batch jobs
+*/
+void endPhase(std::string name, std::chrono::steady_clock::time_point start, std::vector<std::pair<std::string, double>> &phases)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    phases.push_back(std::make_pair(name, seconds));
+    std::cout << name << " took " << seconds << " s" << std::endl;
+}
 
 /*
 *   Input: Comman line arguments specifying the names of each users csv file
@@ -524,38 +245,183 @@ int main(int argc, char *argv[])
     // Vector to hold any ammount of user log files
     vector<string>users;
 
-    string osmFile = argv[1];
+    // Number of threads used to parse logs and check building occupancy, 1 does everything in turn on the main thread
+    int workers = 1;
+
+    // Named pipe (or - for stdin) to read tagged location records from instead of csv files
+    string streamSource;
+
+    // Area covered by the map in streaming mode: min lon, min lat, max lon, max lat
+    string bbox;
+
+    // Format of the path and occupancy output files
+    outputFormat format = FORMAT_GEOJSON;
+
+    // Whether or not the navisens tracks are matched to the road network
+    bool match = false;
+
+    // Whether or not the navisens tracks are compared against the gps tracks
+    bool drift = false;
+
+    // Classes of highway gathered from the osm file
+    string highwayClasses = HIGHWAY_CLASSES;
+
+    // Number of tiles whose map query results are cached
+    long tileCacheSize = TILE_CACHE_SIZE;
+
+    // Zoom of the tiles the users pass through, dense tiles are split further and sparse ones merged by the map
+    long zoom = ZOOM;
+
+    // Whether or not the program exits once the results are written instead of starting playback
+#ifdef HEADLESS
+    bool batch = true;
+#else
+    bool batch = false;
+#endif
+
+    // Separate the options from the osm file and csv filenames
+    vector<string> args;
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if((arg == "-j" || arg == "--threads") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if(arg == "--stream" && i + 1 < argc)
+            streamSource = argv[++i];
+        else if(arg == "--bbox" && i + 1 < argc)
+            bbox = argv[++i];
+        else if(arg == "--match")
+            match = true;
+        else if(arg == "--drift")
+            drift = true;
+        else if(arg == "--batch")
+            batch = true;
+        else if(arg == "--highways" && i + 1 < argc)
+            highwayClasses = argv[++i];
+        else if(arg == "--tile-cache" && i + 1 < argc)
+            tileCacheSize = std::max(0L, atol(argv[++i]));
+        else if(arg == "--zoom" && i + 1 < argc)
+            zoom = std::min(long(MAX_ZOOM), std::max(0L, atol(argv[++i])));
+        else if(arg == "--format" && i + 1 < argc)
+        {
+            if(!parseFormat(argv[++i], format))
+            {
+                std::cerr << "Unknown format " << argv[i] << ", expected geojson, ndjson, ndjson.gz or binary" << std::endl;
+                return 1;
+            }
+        }
+        else
+            args.push_back(arg);
+    }
+
+    if(args.size() < 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-j threads] [--format geojson|ndjson|ndjson.gz|binary] [--tile-cache tiles] [--zoom level] [--highways class,class...] [--match] [--drift] [--batch] map.osm user1.csv user2.csv ..." << std::endl;
+        std::cerr << "       " << argv[0] << " --stream fifo|- --bbox minlon,minlat,maxlon,maxlat map.osm" << std::endl;
+        return 1;
+    }
+
+    string osmFile = args[0];
+
+    if(!streamSource.empty())
+    {
+        double corners[4];
+        const char *p = bbox.c_str();
+        const char *end = p + bbox.size();
+        for(int i = 0; i < 4; i++)
+        {
+            if(p >= end || !parseField(p, end, corners[i]))
+            {
+                std::cerr << "Streaming needs the area of the map, for example --bbox -80.01,40.0,-79.99,40.02" << std::endl;
+                return 1;
+            }
+        }
+
+        std::cerr << "Gathering map data from osm file" << std::endl;
+        Map map(osmium::Box(corners[0], corners[1], corners[2], corners[3]), osmFile, true, highwayClasses, zoom);
+        streamOccupancy(map, streamSource);
+        return 0;
+    }
 
     // Load each argument (csv filename)
-    for(int i = 2; i < argc; i++)
-        users.push_back(argv[i]);
+    for(int i = 1; i < args.size(); i++)
+        users.push_back(args[i]);
+
+    // Vector to hold the column trace of each users log file
+    vector<userTrace> data(users.size());
 
-    // Vector to hold the entries to each users log files
-    vector<vector<locationEntry>> data;
+    // Time taken by every phase of the run, printed together at the end
+    vector<pair<string, double>> phases;
+    auto runStart = std::chrono::steady_clock::now();
+    auto phaseStart = runStart;
+    bool missingLogs = false;
 
-    // For each user log file, tokenize its entries and store them in the data vector
-    std::cout << "Tokenizing csv files" << std::endl;
+    // For each user log file, load its trace (from the binary cache when it is up to date) and store it in the data vector
+    std::cout << "Loading user traces" << std::endl;
     for(int i = 0; i < users.size(); i++)
     {
         std::string filename;
-        vector<locationEntry> temp;
-        tokenizeLog(temp, users[i]);
-        data.push_back(temp);
+        if(!data[i].load(users[i], workers))
+        {
+            std::cerr << "Could not read " << users[i] << std::endl;
+            missingLogs = true;
+        }
         
         filename.append("user");
         filename.append(std::to_string(i+1));
-        filename.append("path.geojson");
-        outputJson(data[i], filename);
+        filename.append("path");
+        filename.append(geojsonExtension(format));
+        outputJson(data[i], filename, format);
     }
+    endPhase("Loading traces", phaseStart, phases);
 
+    // Only needs the traces, so it runs before the map is built
+    if(drift)
+    {
+        phaseStart = std::chrono::steady_clock::now();
+        analyzeDrift(data, workers);
+        endPhase("Drift analysis", phaseStart, phases);
+    }
+
+    phaseStart = std::chrono::steady_clock::now();
     std::cout << "Gathering map data from osm file" << std::endl;
-    Map map = createMap(data, osmFile);
+    Map map = createMap(data, osmFile, highwayClasses, zoom);
+    map.setTileCacheSize(tileCacheSize);
+    endPhase("Building map", phaseStart, phases);
 
-    for(int i = 0; i < data.size(); i++)
-        getOccupiedBuildings(map, data[i], i+1);
-    
+    phaseStart = std::chrono::steady_clock::now();
+    if(workers == 1)
+    {
+        for(int i = 0; i < data.size(); i++)
+            getOccupiedBuildings(map, data[i], i+1, format);
+    }else
+        getOccupiedBuildings(map, data, workers, format);
+    endPhase("Occupancy", phaseStart, phases);
+
+    if(match)
+    {
+        phaseStart = std::chrono::steady_clock::now();
+        matchTraces(map, data, workers, format);
+        endPhase("Map matching", phaseStart, phases);
+    }
+
+    std::cout << "Phase timings:";
+    for(auto& phase : phases)
+        std::cout << " " << phase.first << " " << phase.second << " s |";
+    std::cout << " Total " << std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count() << " s" << std::endl;
+
+    // Batch runs stop here, a missing log is reported through the exit code so job schedulers notice it
+    if(batch)
+        return missingLogs ? 1 : 0;
+
+#ifndef HEADLESS
     // Function to handle moving through data
     parseData(data, map);
+#endif
+
+    cacheStats cache = map.getTileCacheStats();
+    std::cout << "Tile cache: " << cache.hits << " hits | " << cache.misses << " misses | " << cache.evictions
+              << " evictions | " << cache.size << "/" << cache.capacity << " tiles" << std::endl;
     
     return 0;
 }
\ No newline at end of file
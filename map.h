@@ -6,54 +6,169 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sstream>
+#include <iomanip>
 #include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <exception>
+#include <thread>
 #include "data.h"
 #include "handlers.h"
+#include "polygon.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "tiles.h"
+#include "quadtree.h"
+#include "threadpool.h"
+#include "cache.h"
+#include "profile.h"
 
 #include <osmium/osm/types.hpp>
+#include <osmium/osm/box.hpp>
 #include <osmium/geom/mercator_projection.hpp>
 #include <osmium/relations/relations_manager.hpp>
 #include <osmium/geom/tile.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/visitor.hpp>
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
 
-#define ZOOM 17
-/* Zoom Value Meaning
-* 11 - City
-* 12 - Town/City District
-* 13 - Suburb
-* 14 -
-* 15 - Small Road
-* 16 - Street
-* 17 - Block/Park
-* 18 - Building/Tree
-*/
+// Stored at the start of every map snapshot, bump the version whenever the layout of the snapshot changes
+#define SNAPSHOT_MAGIC "NAVMAPSN"
+#define SNAPSHOT_VERSION 5
+
+// Number of decoded osm buffers allowed to wait for each handler thread
+#define OSM_BUFFER_QUEUE 32
+
+// Roads within this many metres of a location are near it
+#define HIGHWAY_RADIUS 50.0
+
+// Mean radius of the earth in metres
+#define EARTH_RADIUS 6371008.8
+
+// Number of tiles whose query results are kept, a walking user stays in the same few tiles for many samples
+#define TILE_CACHE_SIZE 1024
+
+// Bounding boxes are stored as (lon, lat) pairs so they line up with osmium::Location
+typedef boost::geometry::model::point<double, 2, boost::geometry::cs::cartesian> boxPoint;
+typedef boost::geometry::model::box<boxPoint> boundingBox;
+typedef std::pair<boundingBox, size_t> boxEntry;  // Bounding box and index into Map::getBuildings()
+typedef boost::geometry::index::rtree<boxEntry, boost::geometry::index::quadratic<16>> buildingTree;
+
+// Road segments are indexed in a local plane measured in metres, see Map::project()
+typedef boost::geometry::model::point<double, 2, boost::geometry::cs::cartesian> planePoint;
+typedef boost::geometry::model::segment<planePoint> roadSegment;
+typedef std::pair<roadSegment, size_t> segmentEntry;  // Segment and index into Map::segmentHighway
+typedef boost::geometry::index::rtree<segmentEntry, boost::geometry::index::quadratic<16>> segmentTree;
+
+// A road near a location
+struct highwayHit {
+    size_t highway;       // Index into Map::getHighways()
+    size_t segment;       // Segment of the road closest to the location
+    double distance;      // Metres from the location to the closest point of the road
+    double lat;           // Closest point of the road
+    double lon;
+};
+
+// Location of every relevant node, sorted by id and searched with a binary search
+typedef osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> nodeLocationIndex;
+
+// Everything a location query returns for one leaf of the tile tree, shared read only between every caller that asks for that tile
+struct tileQuery {
+    std::vector<size_t> buildings;                  // Indices into Map::getBuildings() whose bounding box overlaps the tile
+    std::vector<osmium::object_id_type> nodes;      // Ids of the relevant nodes in the tile, ascending
+};
 
 class Map 
 {
     public:
-        Map(std::vector<std::vector<locationEntry>> &data, std::string osmFile);
-        std::vector<int> getIds(osmium::Location &loc);
-        std::vector<building> getBuildings(osmium::Location &loc);
-        std::vector<building> getBuildings();
-        std::vector<highway> getHighways(osmium::Location &loc);
+        Map(std::vector<std::vector<locationEntry>> &data, std::string osmFile, bool useSnapshot = true,
+            std::string highwayClasses = HIGHWAY_CLASSES, uint32_t zoom = ZOOM);
+        Map(std::vector<userTrace> &traces, std::string osmFile, bool useSnapshot = true,
+            std::string highwayClasses = HIGHWAY_CLASSES, uint32_t zoom = ZOOM);
+        Map(const osmium::Box &area, std::string osmFile, bool useSnapshot = true,
+            std::string highwayClasses = HIGHWAY_CLASSES, uint32_t zoom = ZOOM);
+        std::shared_ptr<const std::vector<osmium::object_id_type>> getIds(const osmium::Location &loc) const;
+        std::shared_ptr<const std::vector<size_t>> getBuildings(const osmium::Location &loc) const;
+        std::vector<size_t> getNearbyBuildings(const osmium::Location &loc) const;
+        osmium::geom::Tile getTile(const osmium::Location &loc) const;
+        uint32_t getZoom() const;
+        const tileTree& getTileTree() const;
+        const buildingTable& getBuildings() const;
+        std::vector<highwayHit> getHighways(const osmium::Location &loc, double radius = HIGHWAY_RADIUS) const;
+        bool getNearestHighway(const osmium::Location &loc, highwayHit &hit) const;
+        void getNearestSegments(const osmium::Location &loc, size_t count, double radius, std::vector<highwayHit> &hits) const;
+        void getRouteDistances(const highwayHit &from, const std::vector<highwayHit> &to, double limit, std::vector<double> &distances) const;
+        const highwayTable& getHighways() const;
+        const std::string& getTag(uint32_t id) const;
+        size_t bytesPerBuilding() const;
+        void setTileCacheSize(size_t tiles);
+        cacheStats getTileCacheStats() const;
+        void getBuildingCandidates(double lat, double lon, std::vector<size_t> &candidates) const;
+        void getBuildingCandidates(double lat, double lon, const std::vector<size_t> &previous, std::vector<size_t> &candidates) const;
+        const polygonSet& getBuildingPolygons() const;
 
     private:
+        void setTiles(std::vector<osmium::Location> &coords);
+        void loadNodes(bool useSnapshot);
         void gatherNodes();
-        bool checkForId(int id);
-        osmium::Location getIdLocation(int id);
+        template <typename... THandlers>
+        static void applyHandlers(boundedQueue<std::shared_ptr<osmium::memory::Buffer>> &queue, std::exception_ptr &error, THandlers&... handlers);
+        bool osmIdentity(std::string &path, uint64_t &size, int64_t &modified) const;
+        std::string snapshotName() const;
+        std::string joinedClasses() const;
+        bool loadSnapshot(const std::string &filename);
+        bool saveSnapshot(const std::string &filename) const;
+        void buildTileIndex();
+        void buildBuildingTree();
+        void buildPolygons();
+        void buildHighwayIndex();
+        planePoint project(double lat, double lon) const;
+        highwayHit segmentHit(const segmentEntry &entry, const planePoint &point) const;
+        std::shared_ptr<const tileQuery> queryTile(const osmium::Location &loc) const;
+        bool checkForId(osmium::object_id_type id) const;
+        osmium::Location getIdLocation(osmium::object_id_type id) const;
         std::vector<osmium::geom::Tile> tiles;
-        std::vector<building> nearbyBuildings;
-        std::vector<highway> nearbyHighways;
+        buildingTable nearbyBuildings;
+        highwayTable nearbyHighways;
+        stringPool tags;                                                     // Every tag value of the relevant buildings and highways
         std::string osmFile;
-        std::map<int, osmium::Location> nodeHashMap;
+        std::vector<std::string> highwayClasses;                             // Classes of highway that are kept, sorted
+        std::unique_ptr<nodeLocationIndex> nodeIndex;                        // Node id -> location for every relevant node
+        uint32_t zoom = ZOOM;                                                // Zoom of the tiles the users pass through
+        tileTree tileIndex;                                                  // Buildings and node ids by tile, split where dense
+        buildingTree buildingBoxes;                                          // Bounding box of every building polygon
+        std::vector<boundingBox> buildingBounds;                             // Same boxes by building, empty without an outline
+        std::vector<uint32_t> neighbourOffset;                               // Building i -> neighbours[neighbourOffset[i]...]
+        std::vector<uint32_t> neighbours;                                    // Other buildings whose bounding box meets its own
+        polygonSet buildingPolygons;                                         // Outline of every building in flat arrays
+        std::unique_ptr<lruCache<uint64_t, tileQuery>> tileCache;            // Recent tile query results, by leaf of tileIndex
+        segmentTree highwaySegments;                                         // Every road segment with both ends known
+        std::vector<uint32_t> segmentHighway;                                // Segment -> index into nearbyHighways
+        std::vector<uint32_t> segmentEnds;                                   // Segment i -> road nodes segmentEnds[2i] and [2i+1]
+        std::vector<planePoint> roadNodes;                                   // Every node at the end of a segment, in the plane
+        std::vector<uint32_t> roadNodeOffset;                                // Road node i -> roadNodeSegments[roadNodeOffset[i]...]
+        std::vector<uint32_t> roadNodeSegments;                              // Segments that start or end at the node
+        double planeLat = 0;                                                 // Latitude the local plane is centred on
+        double planeScale = 1;                                               // Cosine of planeLat
 };
 
 /*  Constructor
-*   Input: locationEntry vector and name of osm file
+*   Input: locationEntry vector, name of osm file, whether or not a snapshot of the result may be used/written, a comma
+*          separated list of the highway classes to keep and the zoom of the tiles to load
 *   Output: Map object that contains the id of all necesarry nodes
 */
-Map::Map(std::vector<std::vector<locationEntry>> &data, std::string file)
+Map::Map(std::vector<std::vector<locationEntry>> &data, std::string file, bool useSnapshot, std::string highways, uint32_t tileZoom)
 {
     osmFile = file;
+    zoom = std::min<uint32_t>(tileZoom, MAX_ZOOM);
+    highwayClasses = splitList(highways);
 
     std::vector<osmium::Location> coords;
 
@@ -65,82 +180,445 @@ Map::Map(std::vector<std::vector<locationEntry>> &data, std::string file)
             coords.push_back(temp);
         }
     }
+
+    setTiles(coords);
+    loadNodes(useSnapshot);
+}
+
+/*  Constructor
+*   Input: Column traces of every user, name of osm file, whether or not a snapshot of the result may be used/written, the
+*          highway classes to keep and the zoom of the tiles to load
+*   Output: Map object that contains the id of all necesarry nodes
+*   Description: Same as the locationEntry constructor but reads the navisens columns directly
+*/
+Map::Map(std::vector<userTrace> &traces, std::string file, bool useSnapshot, std::string highways, uint32_t tileZoom)
+{
+    osmFile = file;
+    zoom = std::min<uint32_t>(tileZoom, MAX_ZOOM);
+    highwayClasses = splitList(highways);
+
+    std::vector<osmium::Location> coords;
+
+    for(auto& trace : traces)
+    {
+        const double *lat = trace.navLat();
+        const double *lon = trace.navLon();
+        for(size_t j = 0; j < trace.size(); j++)
+            coords.push_back(osmium::Location{lon[j], lat[j]});
+    }
+
+    setTiles(coords);
+    loadNodes(useSnapshot);
+}
+
+/*  Constructor
+*   Input: Area the users will be in, name of osm file, whether or not a snapshot of the result may be used/written, the
+*          highway classes to keep and the zoom of the tiles to load
+*   Output: Map object that contains the id of all necesarry nodes
+*   Description: Used when the user locations are not known up front, covers every tile that overlaps the area
+*/
+Map::Map(const osmium::Box &area, std::string file, bool useSnapshot, std::string highways, uint32_t tileZoom)
+{
+    osmFile = file;
+    zoom = std::min<uint32_t>(tileZoom, MAX_ZOOM);
+    highwayClasses = splitList(highways);
+
+    osmium::geom::Tile corner1(zoom, area.bottom_left());
+    osmium::geom::Tile corner2(zoom, area.top_right());
+    for(uint32_t x = std::min(corner1.x, corner2.x); x <= std::max(corner1.x, corner2.x); x++)
+        for(uint32_t y = std::min(corner1.y, corner2.y); y <= std::max(corner1.y, corner2.y); y++)
+            tiles.push_back(osmium::geom::Tile(zoom, x, y));
+    sort( tiles.begin(), tiles.end() );
+
+    loadNodes(useSnapshot);
+}
+
+/*
+*   Input: Every user location
+*   Output: Nothing
+*   Description: Stores the unique set of tiles the users pass through
+*/
+void Map::setTiles(std::vector<osmium::Location> &coords)
+{
     sort( coords.begin(), coords.end() );
     coords.erase( unique( coords.begin(), coords.end() ), coords.end() );
 
     for(auto& loc : coords)
     {
-        osmium::geom::Tile tempTile(ZOOM, loc);
+        osmium::geom::Tile tempTile(zoom, loc);
         tiles.push_back(tempTile);
     }
     sort( tiles.begin(), tiles.end() );
     tiles.erase( unique( tiles.begin(), tiles.end() ), tiles.end() );
+}
+
+/*
+*   Input: location
+*   Output: Everything the map holds for the leaf of the tile tree the location falls in
+*   Description: Consecutive samples of a user almost always fall in the same leaf, so results are kept in a bounded
+*                cache and every caller asking about a cached leaf shares the same copy. Locations outside every leaf
+*                share one empty result
+*/
+std::shared_ptr<const tileQuery> Map::queryTile(const osmium::Location &loc) const
+{
+    uint32_t leaf = tileIndex.find(loc);
 
-    gatherNodes();
+    return tileCache->get(leaf, [this, leaf]{
+        tileQuery result;
+        if(leaf != tileTree::NO_LEAF){
+            result.buildings.assign(tileIndex.buildings(leaf), tileIndex.buildings(leaf) + tileIndex.buildingCount(leaf));
+            result.nodes.assign(tileIndex.nodes(leaf), tileIndex.nodes(leaf) + tileIndex.nodeCount(leaf));
+        }
+        return result;
+    });
 }
 
 /*
 *   Input: location
 *   Output: A list of the id of every node that exists within the same tile as the input
 */
-std::vector<int> Map::getIds(osmium::Location &loc)
+std::shared_ptr<const std::vector<osmium::object_id_type>> Map::getIds(const osmium::Location &loc) const
 {
-    std::vector<int> ids;
-
-    osmium::geom::Tile userTile(ZOOM, loc);
-    
-    for(std::map<int, osmium::Location>::iterator i = nodeHashMap.begin(); i != nodeHashMap.end(); i++){
-        osmium::geom::Tile tempTile(ZOOM, i->second);
-        if(userTile == tempTile)
-            ids.push_back(i->first);
-    }
+    std::shared_ptr<const tileQuery> result = queryTile(loc);
+    return std::shared_ptr<const std::vector<osmium::object_id_type>>(result, &result->nodes);
+}
 
-    return ids;
+/*
+*   Input: location
+*   Output: The index into getBuildings() of every building whose bounding box overlaps the tile of the users location
+*/
+std::shared_ptr<const std::vector<size_t>> Map::getBuildings(const osmium::Location &loc) const
+{
+    std::shared_ptr<const tileQuery> result = queryTile(loc);
+    return std::shared_ptr<const std::vector<size_t>>(result, &result->buildings);
 }
 
 /*
 *   Input: location
-*   Output: A list of buildings that exist within the same tile as the users location and their information
+*   Output: The index into getBuildings() of every building in the same tile as the location or in one of the tiles
+*           around it, ascending
+*   Description: Neighbouring tiles may be larger or smaller than the users own, see tileTree::neighbours()
 */
-std::vector<building> Map::getBuildings(osmium::Location &loc)
+std::vector<size_t> Map::getNearbyBuildings(const osmium::Location &loc) const
 {
-    std::vector<building> buildings;
+    std::vector<size_t> buildings;
+    uint32_t leaf = tileIndex.find(loc);
+    if(leaf == tileTree::NO_LEAF)
+        return buildings;
 
-    osmium::geom::Tile userTile(ZOOM, loc);
-    for(auto& b : nearbyBuildings)
-    {
-        if(b.location.is_defined()){
-            osmium::geom::Tile tempTile(ZOOM, b.location);
-            if(tempTile == userTile)
-                buildings.push_back(b);
-        }else if(b.nodeLocations.size() > 0){
-            for(auto& l : b.nodeLocations){
-                osmium::geom::Tile tempTile(ZOOM, l);
-                if(tempTile == userTile){
-                    buildings.push_back(b);
-                    break;
-                }
-            }
-        }
-    }
+    std::vector<uint32_t> leaves;
+    tileIndex.neighbours(leaf, leaves);
+    leaves.push_back(leaf);
+    for(auto& next : leaves)
+        buildings.insert(buildings.end(), tileIndex.buildings(next), tileIndex.buildings(next) + tileIndex.buildingCount(next));
+
+    sort( buildings.begin(), buildings.end() );
+    buildings.erase( unique( buildings.begin(), buildings.end() ), buildings.end() );
     return buildings;
 }
 
-std::vector<building> Map::getBuildings()
+/*
+*   Input: location
+*   Output: Leaf of the tile tree the location falls in, or the tile at the map's zoom when the tree holds nothing there
+*/
+osmium::geom::Tile Map::getTile(const osmium::Location &loc) const
+{
+    uint32_t leaf = tileIndex.find(loc);
+    if(leaf == tileTree::NO_LEAF)
+        return osmium::geom::Tile(zoom, loc);
+    return tileIndex.tile(leaf);
+}
+
+/*
+*   Input: Nothing
+*   Output: Zoom of the tiles the users pass through
+*/
+uint32_t Map::getZoom() const
+{
+    return zoom;
+}
+
+/*
+*   Input: Nothing
+*   Output: Tile tree behind the location queries
+*/
+const tileTree& Map::getTileTree() const
+{
+    return tileIndex;
+}
+
+/*
+*   Input: Number of tiles to keep query results for, 0 disables the cache
+*   Output: Nothing
+*/
+void Map::setTileCacheSize(size_t tiles)
+{
+    tileCache->resize(tiles);
+}
+
+/*
+*   Input: Nothing
+*   Output: Hit, miss and eviction counts of the tile query cache
+*/
+cacheStats Map::getTileCacheStats() const
+{
+    return tileCache->stats();
+}
+
+/*
+*   Input: Nothing
+*   Output: Every relevant building, tag values are looked up with getTag()
+*/
+const buildingTable& Map::getBuildings() const
 {
     return nearbyBuildings;
 }
 
 /*
-* Input: user location
-* Output: roads near the user
-* Description: Takes the users location and returns all nearby residential roads
+*   Input: User latitude and longitude, vector to hold the result
+*   Output: The index into getBuildings() of every building polygon whose bounding box contains the location
+*   Description: Broadphase for point in polygon tests. Only the returned buildings can possibly contain the location
+*/
+void Map::getBuildingCandidates(double lat, double lon, std::vector<size_t> &candidates) const
+{
+    candidates.clear();
+
+    std::vector<boxEntry> hits;
+    buildingBoxes.query(boost::geometry::index::intersects(boxPoint(lon, lat)), std::back_inserter(hits));
+
+    for(auto& hit : hits)
+        candidates.push_back(hit.second);
+
+    // Keep the candidates in the same order as getBuildings()
+    sort( candidates.begin(), candidates.end() );
+}
+
+/*
+*   Input: User latitude and longitude, buildings that contained the users previous location (ascending), vector to hold
+*          the result
+*   Output: Same as getBuildingCandidates(lat, lon, candidates)
+*   Description: Consecutive samples are usually in the same building. Any building whose bounding box contains a location
+*                inside the box of a previous building has a box that meets that one, so while the user stays inside
+*                the box only that building and its neighbours are checked and the R-tree is never touched
 */
-std::vector<highway> Map::getHighways(osmium::Location &loc)
+void Map::getBuildingCandidates(double lat, double lon, const std::vector<size_t> &previous, std::vector<size_t> &candidates) const
+{
+    boxPoint point(lon, lat);
+    if(previous.empty() || !boost::geometry::covered_by(point, buildingBounds[previous[0]])){
+        getBuildingCandidates(lat, lon, candidates);
+        return;
+    }
+
+    candidates.clear();
+    size_t last = previous[0];
+    candidates.push_back(last);
+    for(uint32_t i = neighbourOffset[last]; i < neighbourOffset[last + 1]; i++)
+        if(boost::geometry::covered_by(point, buildingBounds[neighbours[i]]))
+            candidates.push_back(neighbours[i]);
+
+    sort( candidates.begin(), candidates.end() );
+}
+
+/*
+* Input: user location, distance in metres
+* Output: Every road with a point within that distance of the user, with the distance to it, nearest first
+* Description: Looks up the road segments whose bounding box overlaps a square around the user in the segment R-tree,
+*              then measures the exact distance to each one. Each road is listed once, at its nearest segment
+*/
+std::vector<highwayHit> Map::getHighways(const osmium::Location &loc, double radius) const
+{
+    std::vector<highwayHit> hits;
+    if(!loc.valid())
+        return hits;
+
+    planePoint point = project(loc.lat(), loc.lon());
+    boundingBox area(planePoint(point.get<0>() - radius, point.get<1>() - radius),
+                     planePoint(point.get<0>() + radius, point.get<1>() + radius));
+
+    std::vector<segmentEntry> candidates;
+    highwaySegments.query(boost::geometry::index::intersects(area), std::back_inserter(candidates));
+
+    for(auto& candidate : candidates){
+        highwayHit hit = segmentHit(candidate, point);
+        if(hit.distance <= radius)
+            hits.push_back(hit);
+    }
+
+    // Keep the nearest segment of every road
+    sort( hits.begin(), hits.end(), [](const highwayHit &a, const highwayHit &b){
+        return a.highway != b.highway ? a.highway < b.highway : a.distance < b.distance;
+    });
+    hits.erase( unique( hits.begin(), hits.end(), [](const highwayHit &a, const highwayHit &b){
+        return a.highway == b.highway;
+    }), hits.end() );
+
+    sort( hits.begin(), hits.end(), [](const highwayHit &a, const highwayHit &b){ return a.distance < b.distance; });
+    return hits;
+}
+
+/*
+* Input: user location, variable to hold the result
+* Output: Whether or not there is any road, and the nearest point of the nearest one
+*/
+bool Map::getNearestHighway(const osmium::Location &loc, highwayHit &hit) const
+{
+    if(!loc.valid() || highwaySegments.empty())
+        return false;
+
+    planePoint point = project(loc.lat(), loc.lon());
+    std::vector<segmentEntry> nearest;
+    highwaySegments.query(boost::geometry::index::nearest(point, 1), std::back_inserter(nearest));
+    if(nearest.empty())
+        return false;
+
+    hit = segmentHit(nearest[0], point);
+    return true;
+}
+
+/*
+* Input: user location, largest number of segments, distance in metres, vector to hold the result
+* Output: Up to count road segments within the distance of the user, nearest first
+* Description: Unlike getHighways() a road can appear more than once, once for each of its nearby segments
+*/
+void Map::getNearestSegments(const osmium::Location &loc, size_t count, double radius, std::vector<highwayHit> &hits) const
+{
+    hits.clear();
+    if(!loc.valid() || highwaySegments.empty() || count == 0)
+        return;
+
+    planePoint point = project(loc.lat(), loc.lon());
+    std::vector<segmentEntry> nearest;
+    highwaySegments.query(boost::geometry::index::nearest(point, count), std::back_inserter(nearest));
+
+    for(auto& segment : nearest){
+        highwayHit hit = segmentHit(segment, point);
+        if(hit.distance <= radius)
+            hits.push_back(hit);
+    }
+    sort( hits.begin(), hits.end(), [](const highwayHit &a, const highwayHit &b){ return a.distance < b.distance; });
+}
+
+/*
+* Input: Point on a road, points on roads to reach from it, longest route in metres, vector to hold the result
+* Output: Length in metres of the shortest route along the roads to each point, infinity when it is longer than limit
+* Description: Dijkstra over the road nodes, starting from both ends of the first segment and stopping once every
+*              route left is longer than limit. Roads are walked in both directions
+*/
+void Map::getRouteDistances(const highwayHit &from, const std::vector<highwayHit> &to, double limit, std::vector<double> &distances) const
+{
+    const double none = std::numeric_limits<double>::infinity();
+    distances.assign(to.size(), none);
+    if(from.segment >= segmentHighway.size())
+        return;
+
+    // Points on the same segment are joined along it
+    planePoint start = project(from.lat, from.lon);
+    for(size_t i = 0; i < to.size(); i++)
+        if(to[i].segment == from.segment)
+            distances[i] = boost::geometry::distance(start, project(to[i].lat, to[i].lon));
+
+    typedef std::pair<double, uint32_t> routeStep;  // Length so far and road node reached
+    std::priority_queue<routeStep, std::vector<routeStep>, std::greater<routeStep>> queue;
+    std::unordered_map<uint32_t, double> reached;
+    for(int end = 0; end < 2; end++){
+        uint32_t node = segmentEnds[2 * from.segment + end];
+        queue.push(routeStep(boost::geometry::distance(start, roadNodes[node]), node));
+    }
+
+    while(!queue.empty()){
+        routeStep step = queue.top();
+        queue.pop();
+        if(step.first > limit)
+            break;
+        if(!reached.emplace(step.second, step.first).second)
+            continue;
+
+        for(uint32_t k = roadNodeOffset[step.second]; k < roadNodeOffset[step.second + 1]; k++){
+            uint32_t segment = roadNodeSegments[k];
+            uint32_t next = segmentEnds[2 * segment] == step.second ? segmentEnds[2 * segment + 1] : segmentEnds[2 * segment];
+            if(reached.count(next) == 0)
+                queue.push(routeStep(step.first + boost::geometry::distance(roadNodes[step.second], roadNodes[next]), next));
+        }
+    }
+
+    for(size_t i = 0; i < to.size(); i++){
+        if(to[i].segment >= segmentHighway.size())
+            continue;
+        planePoint end = project(to[i].lat, to[i].lon);
+        for(int side = 0; side < 2; side++){
+            auto node = reached.find(segmentEnds[2 * to[i].segment + side]);
+            if(node != reached.end())
+                distances[i] = std::min(distances[i], node->second + boost::geometry::distance(roadNodes[node->first], end));
+        }
+        if(distances[i] > limit)
+            distances[i] = none;
+    }
+}
+
+/*
+*   Input: Nothing
+*   Output: Every relevant highway, tag values are looked up with getTag()
+*/
+const highwayTable& Map::getHighways() const
 {
     return nearbyHighways;
 }
 
+/*
+*   Input: Tag index stored in a building or highway column
+*   Output: The tag value
+*/
+const std::string& Map::getTag(uint32_t id) const
+{
+    return tags.get(id);
+}
+
+/*
+*   Input: Nothing
+*   Output: Average number of bytes used by a building record, counting every tag value it could refer to
+*/
+size_t Map::bytesPerBuilding() const
+{
+    if(nearbyBuildings.size() == 0)
+        return 0;
+    return (nearbyBuildings.usedMemory() + tags.usedMemory()) / nearbyBuildings.size();
+}
+
+/*
+*   Input: Whether or not a snapshot may be used/written
+*   Output: Nothing
+*   Description: Loads the relevant part of the osm file from a snapshot when one exists for this file and tile set,
+*                otherwise extracts it from the osm file and saves a snapshot for next time. Then builds the query indexes
+*/
+void Map::loadNodes(bool useSnapshot)
+{
+    std::string snapshot;
+    if(useSnapshot)
+        snapshot = snapshotName();
+
+    if(!snapshot.empty() && loadSnapshot(snapshot)){
+        std::cout << "Loaded map snapshot " << snapshot << std::endl;
+    }else{
+        gatherNodes();
+        if(!snapshot.empty() && !saveSnapshot(snapshot))
+            std::cerr << "Could not write map snapshot " << snapshot << std::endl;
+    }
+
+    {
+        PROFILE_SCOPE(PROFILE_BUILD_INDEXES);
+        buildTileIndex();
+        buildBuildingTree();
+        buildPolygons();
+        buildHighwayIndex();
+    }
+    tileCache.reset(new lruCache<uint64_t, tileQuery>(TILE_CACHE_SIZE));
+
+    std::cout << "\nRelevant" << std::endl;
+    std::cout << "Nodes: " << nodeIndex->size() << " | Buildings: " << nearbyBuildings.size() << " | " << "Highways: " << nearbyHighways.size() << std::endl;
+    std::cout << "Road segments: " << segmentHighway.size() << " | Tag values: " << tags.size() << " | Bytes per building: " << bytesPerBuilding() << std::endl;
+    std::cout << "Zoom: " << zoom << " | Tiles: " << tileIndex.leafCount() << " | Deepest tile: " << tileIndex.deepest() << std::endl;
+}
+
 /*
 *   Input: osm file name
 *   Output: Nothing
@@ -148,95 +626,640 @@ std::vector<highway> Map::getHighways(osmium::Location &loc)
 */
 void Map::gatherNodes()
 {
-    std::vector<std::pair<osmium::Location, int>> nodes;
-    std::vector<building> buildings;
-    std::vector<highway> highways;
+    PROFILE_SCOPE(PROFILE_GATHER_NODES);
     try{
-        osmium::io::Reader reader{osmFile, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
-        nodeHandler nHandler;
-        buildingHandler bHandler;
-        highwayHandler hHandler;
+        tileFilter filter(tiles);
+
+        // The file format (xml, pbf, compressed xml...) is picked from the file name. Decoding happens on the
+        // reader's own thread pool, metadata (users, versions, timestamps) is never needed so it is skipped
+        osmium::io::Reader reader{osmFile, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way, osmium::io::read_meta::no};
+        nodeHandler nHandler(filter);
+        stringPool pool;
+        buildingHandler bHandler(pool);
+        highwayHandler hHandler(pool, highwayClasses);
 
-        osmium::apply(reader, nHandler, bHandler, hHandler);
+        // Nodes and ways are handled on two threads of their own while the reader keeps decoding. Every decoded
+        // buffer is shared with both threads, which only read from it
+        boundedQueue<std::shared_ptr<osmium::memory::Buffer>> nodeQueue(OSM_BUFFER_QUEUE), wayQueue(OSM_BUFFER_QUEUE);
+        std::exception_ptr nodeError, wayError;
+        std::thread nodeThread([&]{ applyHandlers(nodeQueue, nodeError, nHandler); });
+        std::thread wayThread([&]{ applyHandlers(wayQueue, wayError, bHandler, hHandler); });
+
+        try{
+            while(osmium::memory::Buffer buffer = reader.read()){
+                std::shared_ptr<osmium::memory::Buffer> shared = std::make_shared<osmium::memory::Buffer>(std::move(buffer));
+                nodeQueue.push(shared);
+                wayQueue.push(shared);
+            }
+        } catch(...){
+            nodeQueue.close();
+            wayQueue.close();
+            nodeThread.join();
+            wayThread.join();
+            throw;
+        }
+        nodeQueue.close();
+        wayQueue.close();
+        nodeThread.join();
+        wayThread.join();
         reader.close();
 
-        nodes = nHandler.getNodes();
-        buildings = bHandler.getBuildings();
-        highways = hHandler.getHighways();
+        if(nodeError)
+            std::rethrow_exception(nodeError);
+        if(wayError)
+            std::rethrow_exception(wayError);
+
+        buildingTable &buildings = bHandler.getBuildings();
+        highwayTable &highways = hHandler.getHighways();
+        std::vector<osmium::object_id_type> &buildingNodes = bHandler.getNodeIds();
+        std::vector<size_t> &buildingOffsets = bHandler.getNodeOffsets();
 
         std::cout << "\nTotals" << std::endl;
-        std::cout << "Nodes: " << nodes.size() << " | Buildings: " << buildings.size() << " | " << "Highways: " << highways.size() << std::endl;
-
-        for(auto& loc: nodes){
-            osmium::geom::Tile tempTile(ZOOM, loc.first);
-            for(auto& tile : tiles)
-                if(tile == tempTile)
-                    nodeHashMap[loc.second] = loc.first;
-                
-                   
-        }
+        std::cout << "Nodes: " << nHandler.getTotal() << " | Buildings: " << buildings.size() << " | " << "Highways: " << highways.size() << std::endl;
 
-        for(auto& b : buildings){
-            if(b.location.is_defined()){
-                osmium::geom::Tile tempTile(ZOOM, b.location);
-                for(auto& tile: tiles)
-                    if(tile == tempTile){
-                        nearbyBuildings.push_back(b);
-                        break;
-                        //std::cout << "Building:" << b.type << " at " << b.houseNumber << " " << b.street << " called " << b.name << std::endl;
-                    }
-            }else if(b.nodeIds.size() > 0){
-                for(auto& id : b.nodeIds){
-                    if (nodeHashMap.find(id) != nodeHashMap.end()){
-                        b.nodeLocations.push_back(nodeHashMap[id]);
-                    }
-                }
-                if(b.nodeLocations.size() > 0){
-                    nearbyBuildings.push_back(b);
-                    //std::cout << "Building:" << b.type << " at " << b.houseNumber << " " << b.street << " called " << b.name << std::endl;
+        // The node handler already dropped every node outside the users tiles
+        nodeIndex.reset(new nodeLocationIndex());
+        for(auto& node : nHandler.getNodes())
+            nodeIndex->set(static_cast<osmium::unsigned_object_id_type>(node.first), node.second);
+        nodeIndex->sort();
+
+        // Only the tag values of relevant buildings and highways are kept, everything else in the pool is dropped
+        tags = stringPool();
+        std::vector<uint32_t> tagMap(pool.size(), UINT32_MAX);
+        auto keepTag = [&](uint32_t id){
+            if(tagMap[id] == UINT32_MAX)
+                tagMap[id] = tags.intern(pool.get(id));
+            return tagMap[id];
+        };
+
+        nearbyBuildings = buildingTable();
+        for(size_t i = 0; i < buildings.size(); i++){
+            size_t first = nearbyBuildings.vertices.size();
+            if(buildings.location[i].is_defined()){
+                if(!filter.contains(buildings.location[i]))
+                    continue;
+            }else{
+                for(size_t j = buildingOffsets[i]; j < buildingOffsets[i + 1]; j++){
+                    osmium::Location location = getIdLocation(buildingNodes[j]);
+                    if(location.is_defined())
+                        nearbyBuildings.vertices.push_back(location);
                 }
+                if(nearbyBuildings.vertices.size() == first)
+                    continue;
             }
+
+            nearbyBuildings.id.push_back(buildings.id[i]);
+            nearbyBuildings.location.push_back(buildings.location[i]);
+            nearbyBuildings.vertexOffset.push_back(nearbyBuildings.vertices.size());
+            nearbyBuildings.type.push_back(keepTag(buildings.type[i]));
+            nearbyBuildings.street.push_back(keepTag(buildings.street[i]));
+            nearbyBuildings.houseNumber.push_back(keepTag(buildings.houseNumber[i]));
+            nearbyBuildings.postalCode.push_back(keepTag(buildings.postalCode[i]));
+            nearbyBuildings.height.push_back(keepTag(buildings.height[i]));
+            nearbyBuildings.name.push_back(keepTag(buildings.name[i]));
         }
-        for(auto& highway : highways){
-            for(auto& nid : highway.nodeIds){
-                if(checkForId(nid)){
-                    nearbyHighways.push_back(highway);
-                    break;
-                }
-            }       
+
+        // Only the nodes inside the users tiles are known so far, which would cut every road off at the tile edges.
+        // The nodes are read once more for the locations of the rest of every highway
+        std::vector<osmium::object_id_type> missing;
+        for(auto& id : highways.nodeIds)
+            if(!checkForId(id))
+                missing.push_back(id);
+        sort( missing.begin(), missing.end() );
+        missing.erase( unique( missing.begin(), missing.end() ), missing.end() );
+
+        if(!missing.empty()){
+            osmium::io::Reader nodeReader{osmFile, osmium::osm_entity_bits::node, osmium::io::read_meta::no};
+            nodeIdHandler idHandler(missing);
+            osmium::apply(nodeReader, idHandler);
+            nodeReader.close();
+
+            for(auto& node : idHandler.getNodes())
+                nodeIndex->set(static_cast<osmium::unsigned_object_id_type>(node.first), node.second);
+            nodeIndex->sort();
+        }
+
+        // A highway is kept when a segment comes within HIGHWAY_RADIUS of the tiles, even without a node inside them
+        double radiusLat = HIGHWAY_RADIUS / (EARTH_RADIUS * M_PI / 180.0);
+        auto nearTiles = [&](const osmium::object_id_type *nodes, uint32_t count){
+            osmium::Location previous;
+            for(uint32_t j = 0; j < count; j++){
+                osmium::Location location = getIdLocation(nodes[j]);
+                if(!location.valid())
+                    continue;
+                if(!previous.valid())
+                    previous = location;
+
+                double minLat = std::min(previous.lat(), location.lat()), maxLat = std::max(previous.lat(), location.lat());
+                double widest = std::min(std::max(fabs(minLat), fabs(maxLat)), MAX_TILE_LAT);
+                double radiusLon = radiusLat / cos(widest * M_PI / 180.0);
+                if(filter.overlaps(std::min(previous.lon(), location.lon()) - radiusLon, minLat - radiusLat,
+                                   std::max(previous.lon(), location.lon()) + radiusLon, maxLat + radiusLat))
+                    return true;
+                previous = location;
+            }
+            return false;
+        };
+
+        nearbyHighways = highwayTable();
+        for(size_t i = 0; i < highways.size(); i++){
+            const osmium::object_id_type *nodes = highways.nodes(i);
+            uint32_t count = highways.nodeCount(i);
+            if(!nearTiles(nodes, count))
+                continue;
+
+            nearbyHighways.id.push_back(highways.id[i]);
+            nearbyHighways.nodeIds.insert(nearbyHighways.nodeIds.end(), nodes, nodes + count);
+            nearbyHighways.nodeOffset.push_back(nearbyHighways.nodeIds.size());
+            nearbyHighways.type.push_back(keepTag(highways.type[i]));
+            nearbyHighways.name.push_back(keepTag(highways.name[i]));
         }
 
-        std::cout << "\nRelevant" << std::endl;
-        std::cout << "Nodes: " << nodeHashMap.size() << " | Buildings: " << nearbyBuildings.size() << " | " << "Highways: " << nearbyHighways.size() << std::endl;
-        
+        nearbyBuildings.shrinkToFit();
+        nearbyHighways.shrinkToFit();
     } catch(const std::exception& e){
         std::cerr << e.what() << '\n';
         std::exit(1);
     }
 }
 
+/*
+* Input: Nothing
+* Output: Nothing
+* Description: Sorts every relevant node and building into the tile tree so location queries only touch the contents of
+*              a single leaf. A building is listed under every leaf its bounding box overlaps, so one that covers a tile
+*              without having a vertex in it is still found
+*/
+void Map::buildTileIndex()
+{
+    // The node index is sorted by id, so each leaf lists its ids in ascending order
+    std::vector<osmium::object_id_type> nodeIds;
+    std::vector<osmium::Location> nodeLocations;
+    for(auto& node : *nodeIndex){
+        if(!node.second.valid())
+            continue;
+        nodeIds.push_back(static_cast<osmium::object_id_type>(node.first));
+        nodeLocations.push_back(node.second);
+    }
+
+    std::vector<osmium::Box> boxes(nearbyBuildings.size());
+    for(size_t i = 0; i < nearbyBuildings.size(); i++){
+        if(nearbyBuildings.location[i].valid()){
+            boxes[i].extend(nearbyBuildings.location[i]);
+        }else{
+            const osmium::Location *outline = nearbyBuildings.outline(i);
+            for(uint32_t j = 0; j < nearbyBuildings.vertexCount(i); j++)
+                if(outline[j].valid())
+                    boxes[i].extend(outline[j]);
+        }
+    }
+
+    tileIndex.build(zoom, nodeIds, nodeLocations, boxes);
+}
+
+/*
+*   Input: Queue of decoded osm buffers, variable to hold the first error and the handlers to run
+*   Output: Nothing
+*   Description: Runs the handlers over every buffer in the queue until it is closed. After an error the remaining
+*                buffers are still taken off the queue so the reader never blocks on a queue nobody empties
+*/
+template <typename... THandlers>
+void Map::applyHandlers(boundedQueue<std::shared_ptr<osmium::memory::Buffer>> &queue, std::exception_ptr &error, THandlers&... handlers)
+{
+    std::shared_ptr<osmium::memory::Buffer> buffer;
+    while(queue.pop(buffer)){
+        if(error)
+            continue;
+        try{
+            osmium::apply(*buffer, handlers...);
+        } catch(...){
+            error = std::current_exception();
+        }
+    }
+}
+
+/*
+*   Input: Nothing
+*   Output: Outline of every building, indexed the same way as getBuildings()
+*/
+const polygonSet& Map::getBuildingPolygons() const
+{
+    return buildingPolygons;
+}
+
+/*
+* Input: Nothing
+* Output: Nothing
+* Description: Copies the outline of every building into contiguous latitude/longitude arrays for the point in polygon kernel
+*/
+void Map::buildPolygons()
+{
+    buildingPolygons = polygonSet();
+
+    buildingPolygons.lat.reserve(nearbyBuildings.vertices.size() + nearbyBuildings.size());
+    buildingPolygons.lon.reserve(nearbyBuildings.vertices.size() + nearbyBuildings.size());
+    buildingPolygons.offset.reserve(nearbyBuildings.size() + 1);
+
+    for(size_t i = 0; i < nearbyBuildings.size(); i++){
+        uint32_t count = nearbyBuildings.vertexCount(i);
+        const osmium::Location *outline = nearbyBuildings.outline(i);
+        if(count >= 3){
+            for(uint32_t j = 0; j < count; j++){
+                buildingPolygons.lat.push_back(outline[j].lat());
+                buildingPolygons.lon.push_back(outline[j].lon());
+            }
+            // Close the ring so edge i always runs from vertex i to vertex i + 1
+            buildingPolygons.lat.push_back(outline[0].lat());
+            buildingPolygons.lon.push_back(outline[0].lon());
+        }
+        buildingPolygons.offset.push_back(buildingPolygons.lat.size());
+    }
+}
+
+/*
+* Input: Nothing
+* Output: Nothing
+* Description: Computes the bounding box of every building polygon once and bulk loads them into an R-tree, then lists
+*              the neighbours of every building (the others whose bounding box meets its own) for the coherent lookup
+*/
+void Map::buildBuildingTree()
+{
+    std::vector<boxEntry> boxes;
+    buildingBounds.assign(nearbyBuildings.size(), boundingBox(boxPoint(0, 0), boxPoint(0, 0)));
+
+    for(size_t i = 0; i < nearbyBuildings.size(); i++){
+        uint32_t count = nearbyBuildings.vertexCount(i);
+        const osmium::Location *outline = nearbyBuildings.outline(i);
+
+        // Buildings without an outline can never contain a location
+        if(count < 3)
+            continue;
+
+        boundingBox box(boxPoint(outline[0].lon(), outline[0].lat()), boxPoint(outline[0].lon(), outline[0].lat()));
+        for(uint32_t j = 1; j < count; j++)
+            boost::geometry::expand(box, boxPoint(outline[j].lon(), outline[j].lat()));
+
+        boxes.push_back(std::make_pair(box, i));
+        buildingBounds[i] = box;
+    }
+
+    // The range constructor uses the packing algorithm, which gives a better tree than inserting one at a time
+    buildingBoxes = buildingTree(boxes.begin(), boxes.end());
+
+    // Buildings without an outline have no neighbours, they can never be the building a user was last in
+    std::vector<std::vector<uint32_t>> lists(nearbyBuildings.size());
+    std::vector<boxEntry> hits;
+    for(auto& entry : boxes){
+        hits.clear();
+        buildingBoxes.query(boost::geometry::index::intersects(entry.first), std::back_inserter(hits));
+        for(auto& hit : hits)
+            if(hit.second != entry.second)
+                lists[entry.second].push_back(hit.second);
+        sort( lists[entry.second].begin(), lists[entry.second].end() );
+    }
+
+    neighbourOffset.assign(1, 0);
+    neighbours.clear();
+    for(auto& list : lists){
+        neighbours.insert(neighbours.end(), list.begin(), list.end());
+        neighbourOffset.push_back(neighbours.size());
+    }
+}
+
+/*
+* Input: Latitude and longitude
+* Output: Position in a plane centred on the map, in metres east and north
+* Description: Equirectangular projection scaled by the cosine of the latitude at the centre of the map. Over the few
+*              kilometres a map covers the error is far below GPS noise, and distances in the plane are plain metres
+*/
+planePoint Map::project(double lat, double lon) const
+{
+    double metres = EARTH_RADIUS * M_PI / 180.0;
+    return planePoint(lon * planeScale * metres, (lat - planeLat) * metres);
+}
+
+/*
+* Input: Road segment from the segment R-tree and a point in the plane
+* Output: Where and how far the closest point of the segment is from the point
+*/
+highwayHit Map::segmentHit(const segmentEntry &entry, const planePoint &point) const
+{
+    double ax = entry.first.first.get<0>(), ay = entry.first.first.get<1>();
+    double dx = entry.first.second.get<0>() - ax, dy = entry.first.second.get<1>() - ay;
+    double length = dx * dx + dy * dy;
+
+    double t = 0;
+    if(length > 0)
+        t = std::max(0.0, std::min(1.0, ((point.get<0>() - ax) * dx + (point.get<1>() - ay) * dy) / length));
+    double x = ax + t * dx, y = ay + t * dy;
+
+    double metres = EARTH_RADIUS * M_PI / 180.0;
+    highwayHit hit;
+    hit.highway = segmentHighway[entry.second];
+    hit.segment = entry.second;
+    hit.distance = std::hypot(point.get<0>() - x, point.get<1>() - y);
+    hit.lat = y / metres + planeLat;
+    hit.lon = x / (planeScale * metres);
+    return hit;
+}
+
+/*
+* Input: Nothing
+* Output: Nothing
+* Description: Splits every highway into segments between consecutive nodes whose location is known and bulk loads
+*              them into an R-tree, so nearby roads can be found without looking at every highway
+*/
+void Map::buildHighwayIndex()
+{
+    // Centre the plane on the tiles the users pass through
+    if(!tiles.empty()){
+        uint32_t minY = tiles[0].y, maxY = tiles[0].y;
+        for(auto& tile : tiles){
+            minY = std::min(minY, tile.y);
+            maxY = std::max(maxY, tile.y);
+        }
+        planeLat = (tileLat(zoom, minY) + tileLat(zoom, maxY + 1.0)) / 2;
+    }
+    planeScale = cos(planeLat * M_PI / 180.0);
+
+    // Highways that share a node share its road node, which is what joins them into a graph for getRouteDistances()
+    std::vector<segmentEntry> segments;
+    std::unordered_map<osmium::object_id_type, uint32_t> roadNodeIds;
+    auto roadNode = [&](osmium::object_id_type id, const planePoint &point){
+        auto inserted = roadNodeIds.emplace(id, roadNodes.size());
+        if(inserted.second)
+            roadNodes.push_back(point);
+        return inserted.first->second;
+    };
+
+    segmentHighway.clear();
+    segmentEnds.clear();
+    roadNodes.clear();
+    for(size_t i = 0; i < nearbyHighways.size(); i++){
+        const osmium::object_id_type *nodes = nearbyHighways.nodes(i);
+        osmium::Location previous;
+        planePoint previousPoint;
+        for(uint32_t j = 0; j < nearbyHighways.nodeCount(i); j++){
+            osmium::Location location = getIdLocation(nodes[j]);
+            planePoint point;
+            if(location.is_defined())
+                point = project(location.lat(), location.lon());
+            if(previous.is_defined() && location.is_defined()){
+                segments.push_back(std::make_pair(roadSegment(previousPoint, point), segmentHighway.size()));
+                segmentHighway.push_back(i);
+                segmentEnds.push_back(roadNode(nodes[j - 1], previousPoint));
+                segmentEnds.push_back(roadNode(nodes[j], point));
+            }
+            previous = location;
+            previousPoint = point;
+        }
+    }
+
+    roadNodeOffset.assign(roadNodes.size() + 1, 0);
+    for(uint32_t node : segmentEnds)
+        roadNodeOffset[node + 1]++;
+    for(size_t i = 0; i < roadNodes.size(); i++)
+        roadNodeOffset[i + 1] += roadNodeOffset[i];
+    roadNodeSegments.resize(segmentEnds.size());
+    std::vector<uint32_t> filled(roadNodeOffset.begin(), roadNodeOffset.end() - 1);
+    for(size_t i = 0; i < segmentEnds.size(); i++)
+        roadNodeSegments[filled[segmentEnds[i]]++] = i / 2;
+
+    highwaySegments = segmentTree(segments.begin(), segments.end());
+}
+
+/*
+* Input: Variables to hold the identity of the osm file
+* Output: Whether or not the osm file exists, along with its absolute path, size and modification time
+*/
+bool Map::osmIdentity(std::string &path, uint64_t &size, int64_t &modified) const
+{
+    struct stat info;
+    if(stat(osmFile.c_str(), &info) != 0)
+        return false;
+
+    char *absolute = realpath(osmFile.c_str(), nullptr);
+    path = absolute ? absolute : osmFile;
+    free(absolute);
+
+    size = info.st_size;
+    modified = modifiedTime(info);
+    return true;
+}
+
+/*
+* Input: Nothing
+* Output: Name of the snapshot for this osm file and tile set, or an empty string if the osm file does not exist
+* Description: Snapshots live next to the osm file and are named after a hash of the file's identity, the tiles
+*              covered and the highway classes kept, so different areas of the same extract get their own snapshot
+*/
+std::string Map::snapshotName() const
+{
+    std::string path;
+    uint64_t size;
+    int64_t modified;
+    if(!osmIdentity(path, size, modified))
+        return "";
+
+    // 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void *data, size_t length){
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < length; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(path.data(), path.size());
+    mix(&size, sizeof(size));
+    mix(&modified, sizeof(modified));
+    std::vector<uint32_t> values = flattenTiles(tiles);
+    mix(values.data(), values.size() * sizeof(uint32_t));
+    for(auto& highwayClass : highwayClasses)
+        mix(highwayClass.c_str(), highwayClass.size() + 1);
+
+    std::ostringstream name;
+    name << osmFile << "." << std::hex << std::setw(16) << std::setfill('0') << hash << ".snapshot";
+    return name.str();
+}
+
+/*
+* Input: Nothing
+* Output: The highway classes kept, as a comma separated list
+*/
+std::string Map::joinedClasses() const
+{
+    std::string joined;
+    for(auto& highwayClass : highwayClasses){
+        if(!joined.empty())
+            joined += ",";
+        joined += highwayClass;
+    }
+    return joined;
+}
+
+/*
+* Input: Name of the snapshot
+* Output: Whether or not the snapshot matched this osm file and tile set and was loaded
+* Description: Memory maps the snapshot and reads the nodes, buildings and highways straight out of it. The header is
+*              checked in full so a hash collision or a stale file is never used
+*/
+bool Map::loadSnapshot(const std::string &filename)
+{
+    PROFILE_SCOPE(PROFILE_LOAD_SNAPSHOT);
+    mappedFile file(filename);
+    if(!file.isOpen() || file.size() == 0)
+        return false;
+
+    snapshotReader in(file.data(), file.size());
+
+    char magic[8];
+    uint32_t version;
+    std::string path, expectedPath;
+    uint64_t size, expectedSize;
+    int64_t modified, expectedModified;
+    std::vector<uint32_t> snapshotTiles;
+    std::string classes;
+
+    if(!in.value(magic) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+        return false;
+    if(!in.value(version) || version != SNAPSHOT_VERSION)
+        return false;
+    if(!osmIdentity(expectedPath, expectedSize, expectedModified))
+        return false;
+    if(!in.string(path) || !in.value(size) || !in.value(modified) || !in.array(snapshotTiles) || !in.string(classes))
+        return false;
+    if(path != expectedPath || size != expectedSize || modified != expectedModified || snapshotTiles != flattenTiles(tiles))
+        return false;
+    if(classes != joinedClasses())
+        return false;
+
+    std::unique_ptr<nodeLocationIndex> nodes(new nodeLocationIndex());
+    buildingTable buildings;
+    highwayTable highways;
+    stringPool pool;
+
+    uint64_t count;
+    in.value(count);
+    for(uint64_t i = 0; i < count && in.good(); i++){
+        osmium::unsigned_object_id_type id;
+        osmium::Location location;
+        in.value(id);
+        in.value(location);
+        nodes->set(id, location);
+    }
+
+    // Buildings and highways are stored column by column, so each column is a single copy out of the file
+    in.array(buildings.id);
+    in.array(buildings.location);
+    in.array(buildings.vertexOffset);
+    in.array(buildings.vertices);
+    in.array(buildings.type);
+    in.array(buildings.street);
+    in.array(buildings.houseNumber);
+    in.array(buildings.postalCode);
+    in.array(buildings.height);
+    in.array(buildings.name);
+
+    in.array(highways.id);
+    in.array(highways.nodeOffset);
+    in.array(highways.nodeIds);
+    in.array(highways.type);
+    in.array(highways.name);
+
+    in.value(count);
+    std::string value;
+    for(uint64_t i = 0; i < count && in.good(); i++){
+        in.string(value);
+        pool.intern(value);
+    }
+
+    if(!in.atEnd() || pool.size() != count || !buildings.consistent(count) || !highways.consistent(count))
+        return false;
+
+    nodeIndex = std::move(nodes);
+    nearbyBuildings = std::move(buildings);
+    nearbyHighways = std::move(highways);
+    tags = std::move(pool);
+    return true;
+}
+
+/*
+* Input: Name of the snapshot
+* Output: Whether or not the snapshot was written
+* Description: Stores the identity of the osm file, the tiles covered, every relevant node, building and highway and the
+*              tag values they refer to
+*/
+bool Map::saveSnapshot(const std::string &filename) const
+{
+    std::string path;
+    uint64_t size;
+    int64_t modified;
+    if(!osmIdentity(path, size, modified))
+        return false;
+
+    char magic[8];
+    memcpy(magic, SNAPSHOT_MAGIC, sizeof(magic));
+
+    snapshotWriter out;
+    out.value(magic);
+    out.value<uint32_t>(SNAPSHOT_VERSION);
+    out.string(path);
+    out.value(size);
+    out.value(modified);
+    out.array(flattenTiles(tiles));
+    out.string(joinedClasses());
+
+    out.value<uint64_t>(nodeIndex->size());
+    for(auto& node : *nodeIndex){
+        out.value(node.first);
+        out.value(node.second);
+    }
+
+    out.array(nearbyBuildings.id);
+    out.array(nearbyBuildings.location);
+    out.array(nearbyBuildings.vertexOffset);
+    out.array(nearbyBuildings.vertices);
+    out.array(nearbyBuildings.type);
+    out.array(nearbyBuildings.street);
+    out.array(nearbyBuildings.houseNumber);
+    out.array(nearbyBuildings.postalCode);
+    out.array(nearbyBuildings.height);
+    out.array(nearbyBuildings.name);
+
+    out.array(nearbyHighways.id);
+    out.array(nearbyHighways.nodeOffset);
+    out.array(nearbyHighways.nodeIds);
+    out.array(nearbyHighways.type);
+    out.array(nearbyHighways.name);
+
+    out.value<uint64_t>(tags.size());
+    for(uint32_t i = 0; i < tags.size(); i++)
+        out.string(tags.get(i));
+
+    return out.save(filename);
+}
+
 /*
 * Input: node id
 * Output: Whether or not that node is nearby the user
-* Description: Uses hashmap search to determine whether or not the specified node is nearby the user
+* Description: Uses a binary search of the node index to determine whether or not the specified node is nearby the user
 */
-bool Map::checkForId(int id)
+bool Map::checkForId(osmium::object_id_type id) const
 {
-    if(nodeHashMap.find(id) != nodeHashMap.end())
-        return true;
-    return false;
+    return getIdLocation(id).is_defined();
 }
 
 /*
 * Input: id
-* Output: Location of node
-* Description: Determines the location of a specified node using hashmap search 
+* Output: Location of node, undefined if the node is not nearby the user
+* Description: Determines the location of a specified node using a binary search of the node index
 */
-osmium::Location Map::getIdLocation(int id)
+osmium::Location Map::getIdLocation(osmium::object_id_type id) const
 {
-   if (nodeHashMap.find(id) != nodeHashMap.end()){
-        return nodeHashMap[id];
-    }
+    if(!nodeIndex)
+        return osmium::Location();
+    return nodeIndex->get_noexcept(static_cast<osmium::unsigned_object_id_type>(id));
 }
 
 #endif
\ No newline at end of file
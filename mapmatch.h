@@ -0,0 +1,288 @@
+#ifndef MAPMATCH_SRC
+#define MAPMATCH_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <mutex>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include "data.h"
+#include "map.h"
+#include "trace.h"
+#include "geojson.h"
+#include "writer.h"
+#include "threadpool.h"
+#include "profile.h"
+
+// Most road segments considered for a single sample, bounds the work per sample to MATCH_CANDIDATES squared transitions
+#define MATCH_CANDIDATES 8
+
+// Roads further than this many metres from a sample are never matched to it
+#define MATCH_RADIUS 50.0
+
+// Standard deviation in metres of the distance between a sample and the road it was taken on
+#define MATCH_SIGMA 10.0
+
+// Scale in metres of the difference between the distance walked and the distance between the matched points, every
+// MATCH_BETA metres of difference makes a transition e times less likely
+#define MATCH_BETA 5.0
+
+// Routes between candidates are only searched up to MATCH_ROUTE_FACTOR times the distance walked plus MATCH_ROUTE_SLACK
+// metres, a candidate with no shorter route from any candidate of the previous sample cannot follow it
+#define MATCH_ROUTE_FACTOR 4.0
+#define MATCH_ROUTE_SLACK (2 * MATCH_SIGMA)
+
+// Result of matching a single sample
+struct matchedSample {
+    bool matched = false;     // False when no road was within MATCH_RADIUS
+    size_t highway = 0;       // Index into Map::getHighways()
+    double lat = 0;           // Matched point on the road
+    double lon = 0;
+    double offset = 0;        // Metres between the navisens location and the matched point
+};
+
+// Candidate kept for the trace back at the end of a chain, stored for every candidate of every sample in the chain
+struct matchCandidate {
+    double lat;
+    double lon;
+    float distance;
+    uint32_t highway;
+};
+
+/*
+*   Input: Two locations
+*   Output: Distance between them in metres
+*   Description: Equirectangular approximation, accurate to well under a metre over the distance between two samples
+*/
+inline double groundDistance(double lat1, double lon1, double lat2, double lon2)
+{
+    double metres = EARTH_RADIUS * M_PI / 180.0;
+    double x = (lon2 - lon1) * cos((lat1 + lat2) * M_PI / 360.0) * metres;
+    double y = (lat2 - lat1) * metres;
+    return sqrt(x * x + y * y);
+}
+
+/*
+*   Input: Map object and the trace of a single user
+*   Output: The matched road point of every sample of the trace
+*   Description: Hidden Markov model map matching solved with the Viterbi algorithm in a single pass over the trace.
+*                The hidden states of a sample are the (at most MATCH_CANDIDATES) nearest road segments. A candidate is
+*                likelier the closer it is to the sample (gaussian with MATCH_SIGMA) and a step between candidates is
+*                likelier the closer the shortest route along the roads between them is to the distance between the two
+*                samples (exponential with MATCH_BETA), so jumping to a road that is near but not connected is ruled out.
+*                A sample with no road nearby, or none reachable from the previous sample, ends the current chain,
+*                which is traced back before a new one starts
+*/
+std::vector<matchedSample> matchTrace(const Map &map, const userTrace &trace)
+{
+    PROFILE_SCOPE(PROFILE_MAP_MATCH);
+    const double *lat = trace.navLat();
+    const double *lon = trace.navLon();
+    size_t n = trace.size();
+    const double unreachable = -std::numeric_limits<double>::infinity();
+
+    std::vector<matchedSample> result(n);
+
+    // Candidates of every sample in the current chain one after another, with the best predecessor of each
+    std::vector<matchCandidate> candidates;
+    std::vector<uint32_t> first;              // Index of the first candidate of each sample in the chain
+    std::vector<uint8_t> back;
+    std::vector<double> previous, current;
+    std::vector<highwayHit> hits, previousHits;
+    std::vector<double> routes;
+    std::vector<uint8_t> from;
+    size_t chainStart = 0;
+
+    // Walks back from the best final candidate of the chain and stores the matched point of every sample in it
+    auto finishChain = [&](size_t chainEnd){
+        if(first.empty())
+            return;
+
+        size_t best = 0;
+        for(size_t j = 1; j < previous.size(); j++)
+            if(previous[j] > previous[best])
+                best = j;
+
+        for(size_t t = chainEnd; t-- > chainStart;){
+            const matchCandidate &candidate = candidates[first[t - chainStart] + best];
+            matchedSample &sample = result[t];
+            sample.matched = true;
+            sample.highway = candidate.highway;
+            sample.lat = candidate.lat;
+            sample.lon = candidate.lon;
+            sample.offset = candidate.distance;
+            best = back[first[t - chainStart] + best];
+        }
+
+        candidates.clear();
+        first.clear();
+        back.clear();
+        previous.clear();
+    };
+
+    for(size_t t = 0; t < n; t++){
+        map.getNearestSegments(osmium::Location(lon[t], lat[t]), MATCH_CANDIDATES, MATCH_RADIUS, hits);
+        if(hits.empty()){
+            finishChain(t);
+            continue;
+        }
+        double walked = t > 0 ? groundDistance(lat[t - 1], lon[t - 1], lat[t], lon[t]) : 0;
+        current.assign(hits.size(), unreachable);
+        from.assign(hits.size(), 0);
+        if(!first.empty()){
+            // Candidates of the previous sample are the last ones stored
+            for(size_t i = 0; i < previousHits.size(); i++){
+                map.getRouteDistances(previousHits[i], hits, MATCH_ROUTE_FACTOR * walked + MATCH_ROUTE_SLACK, routes);
+                for(size_t j = 0; j < hits.size(); j++){
+                    double score = previous[i] - fabs(walked - routes[j]) / MATCH_BETA;
+                    if(score > current[j]){
+                        current[j] = score;
+                        from[j] = i;
+                    }
+                }
+            }
+            if(*std::max_element(current.begin(), current.end()) == unreachable)
+                finishChain(t);
+        }
+        if(first.empty()){
+            chainStart = t;
+            std::fill(current.begin(), current.end(), 0.0);
+            std::fill(from.begin(), from.end(), 0);
+        }
+
+        uint32_t offset = candidates.size();
+        for(size_t j = 0; j < hits.size(); j++){
+            current[j] += -0.5 * (hits[j].distance / MATCH_SIGMA) * (hits[j].distance / MATCH_SIGMA);
+            back.push_back(from[j]);
+            candidates.push_back(matchCandidate{hits[j].lat, hits[j].lon, static_cast<float>(hits[j].distance),
+                                                static_cast<uint32_t>(hits[j].highway)});
+        }
+        first.push_back(offset);
+        previous.swap(current);
+        previousHits.swap(hits);
+    }
+    finishChain(n);
+
+    return result;
+}
+
+/*
+*   Input: Map object, trace of a user, its matched samples, unique user identifier and output format
+*   Output: userNmatched with a line string for every stretch of matched samples, and userNoffsets.csv with the matched
+*           point and the distance to it for every sample (blank when the sample was not matched)
+*/
+void outputMatch(const Map &map, const userTrace &trace, const std::vector<matchedSample> &matched, int usernum,
+                 outputFormat format)
+{
+    std::string filename = "user" + std::to_string(usernum) + "matched" + geojsonExtension(format);
+    geojsonWriter path(filename, format);
+    if(!path.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    path.beginCollection();
+    for(size_t i = 0; i < matched.size();)
+    {
+        if(!matched[i].matched)
+        {
+            i++;
+            continue;
+        }
+
+        path.beginFeature();
+        path.text("{\"type\": \"Feature\", \"geometry\": { \"type\": \"LineString\", \"coordinates\":  [");
+        size_t j = i;
+        for(; j < matched.size() && matched[j].matched; j++)
+        {
+            if(j != i)
+                path.text(", ");
+            path.coordinate(matched[j].lon, matched[j].lat);
+        }
+        i = j;
+        path.text("] }, \"properties\": {\"stroke\":\" #e3a716\"} }");
+        path.endFeature();
+    }
+    path.endCollection();
+    if(!path.close())
+        std::cerr << "Could not write " << filename << std::endl;
+
+    filename = "user" + std::to_string(usernum) + "offsets.csv";
+    bufferedWriter offsets(filename);
+    if(!offsets.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    const highwayTable &highways = map.getHighways();
+    offsets.text("Timestamp,Nav Lat,Nav Lon,Matched Lat,Matched Lon,Offset,Highway\n");
+    for(size_t i = 0; i < matched.size(); i++)
+    {
+        offsets.number(trace.timestamp()[i]);
+        offsets.text(",");
+        offsets.number(trace.navLat()[i]);
+        offsets.text(",");
+        offsets.number(trace.navLon()[i]);
+        offsets.text(",");
+        if(matched[i].matched)
+        {
+            offsets.number(matched[i].lat);
+            offsets.text(",");
+            offsets.number(matched[i].lon);
+            offsets.text(",");
+            offsets.number(matched[i].offset);
+            offsets.text(",");
+            offsets.integer(highways.id[matched[i].highway]);
+            offsets.text("\n");
+        }else
+            offsets.text(",,,\n");
+    }
+    if(!offsets.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+/*
+*   Input: Map object, every users trace, number of worker threads and output format
+*   Output: The matched path and per sample offsets of every user
+*   Description: Users are matched in parallel, each one by a single worker since the Viterbi pass runs in sample order
+*/
+void matchTraces(const Map &map, std::vector<userTrace> &data, int workers, outputFormat format)
+{
+    threadPool pool(workers);
+    std::mutex outputLock;
+    std::cout << "Matching " << data.size() << " users to " << map.getHighways().size() << " highways on " << pool.size()
+              << " threads" << std::endl;
+
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        pool.submit([&map, &data, &outputLock, format, i]{
+            std::vector<matchedSample> matched = matchTrace(map, data[i]);
+            outputMatch(map, data[i], matched, i + 1, format);
+
+            size_t count = 0;
+            double total = 0;
+            for(auto& sample : matched)
+            {
+                if(sample.matched)
+                {
+                    count++;
+                    total += sample.offset;
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(outputLock);
+            std::cout << "Matched " << count << " of " << matched.size() << " samples for user " << i + 1;
+            if(count > 0)
+                std::cout << " (mean offset " << total / count << " m)";
+            std::cout << std::endl;
+        });
+    }
+    pool.wait();
+}
+
+#endif
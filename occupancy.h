@@ -0,0 +1,126 @@
+#ifndef OCCUPANCY_SRC
+#define OCCUPANCY_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include "data.h"
+#include "map.h"
+#include "trace.h"
+#include "geojson.h"
+#include "results.h"
+#include "threadpool.h"
+#include "visits.h"
+
+// Number of samples one worker checks at a time when a single trace is split across workers
+#define OCCUPANCY_CHUNK 65536
+
+/*
+* Input: Map object, index of every building the user entered, unique user identifier, output format
+* Output: A file containing the buildings the user encounters as well as which ones are entered, or only the entered
+*         buildings for the binary format
+*/
+void outputOccupiedBuildings(Map &map, const std::vector<size_t> &entered, int usernum, outputFormat format)
+{
+    std::string filename = "user";
+    filename.append(std::to_string(usernum));
+    filename.append("buildings");
+
+    if(format == FORMAT_BINARY)
+    {
+        filename.append(".occupancy");
+        if(!saveOccupancy(map.getBuildings(), entered, usernum, filename))
+            std::cerr << "Could not write " << filename << std::endl;
+        return;
+    }
+
+    std::vector<char> flags(map.getBuildings().size(), false);
+    for(auto& index : entered)
+        flags[index] = true;
+
+    filename.append(geojsonExtension(format));
+    outputJson(map.getBuildings(), flags, filename, format);
+}
+
+/*
+* Input: Map object, User locaitons, unique user identifier, output format
+* Output: A file containing the buildings the user encounters as well as which ones are entered, and a file with every
+*         visit of the user to a building
+* Description: Takes in a users location data, their user number, and the buildings in order to calculate which buildings this specific user enters
+*/
+void getOccupiedBuildings(Map &map, const userTrace &user, int usernum, outputFormat format)
+{
+    std::cout << "Checking " << map.getBuildingPolygons().size() << " buildings against " << user.size() << " locations for user " << usernum << std::endl;
+
+    std::vector<buildingVisit> visits = getBuildingVisits(map, user, 0, user.size());
+    mergeVisits(visits);
+    std::vector<size_t> entered = visitedBuildings(visits);
+    outputOccupiedBuildings(map, entered, usernum, format);
+    outputVisits(map, visits, usernum);
+}
+
+/*
+* Input: Map object, every users locations, number of worker threads, output format
+* Output: Files per user containing the buildings the user encounters as well as which ones are entered, and their visits
+* Description: Same output as calling getOccupiedBuildings for each user in turn. Every user is split into chunks of at
+*              most OCCUPANCY_CHUNK samples that are checked in parallel against the shared map. Once the last chunk of a
+*              user finishes, its visits are merged across the chunk boundaries and that users files are written straight away
+*/
+void getOccupiedBuildings(Map &map, std::vector<userTrace> &data, int workers, outputFormat format)
+{
+    // Results for one user, filled in by whichever workers check its chunks
+    struct userResult {
+        std::vector<std::vector<buildingVisit>> chunks;
+        std::atomic<size_t> remaining;
+    };
+
+    std::vector<std::unique_ptr<userResult>> results;
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        size_t chunks = std::max<size_t>(1, (data[i].size() + OCCUPANCY_CHUNK - 1) / OCCUPANCY_CHUNK);
+        results.push_back(std::unique_ptr<userResult>(new userResult));
+        results[i]->chunks.resize(chunks);
+        results[i]->remaining = chunks;
+    }
+
+    threadPool pool(workers);
+    std::mutex outputLock;
+    std::cout << "Checking occupancy for " << data.size() << " users on " << pool.size() << " threads" << std::endl;
+
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        std::cout << "Checking " << map.getBuildingPolygons().size() << " buildings against " << data[i].size() << " locations for user " << i + 1 << std::endl;
+
+        for(size_t c = 0; c < results[i]->chunks.size(); c++)
+        {
+            pool.submit([&map, &data, &results, &outputLock, format, i, c]{
+                userResult &result = *results[i];
+                size_t begin = c * OCCUPANCY_CHUNK;
+                size_t end = std::min(begin + OCCUPANCY_CHUNK, data[i].size());
+                result.chunks[c] = getBuildingVisits(map, data[i], begin, end);
+
+                // The last chunk to finish merges the others and writes the file
+                if(--result.remaining == 0)
+                {
+                    std::vector<buildingVisit> visits;
+                    for(auto& chunk : result.chunks)
+                        visits.insert(visits.end(), chunk.begin(), chunk.end());
+                    mergeVisits(visits);
+
+                    outputOccupiedBuildings(map, visitedBuildings(visits), i + 1, format);
+                    outputVisits(map, visits, i + 1);
+
+                    std::lock_guard<std::mutex> guard(outputLock);
+                    std::cout << "Finished user " << i + 1 << std::endl;
+                }
+            });
+        }
+    }
+    pool.wait();
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef PLAYBACK_SRC
+#define PLAYBACK_SRC
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include "data.h"
+#include "trace.h"
+
+// Longest the playback loop sleeps before checking for window events again
+#define PLAYBACK_POLL std::chrono::milliseconds(10)
+
+// Seconds of log skipped by a single jump
+#define PLAYBACK_SKIP 10.0
+
+// Playback time in log seconds, driven by the monotonic clock so it only depends on how much real time has passed
+// Playback time is origin + (steady time since start) * speed, negated while playing backwards
+class playbackClock
+{
+    public:
+        double now() const;
+        bool playing() const;
+        bool forward() const;
+        double getSpeed() const;
+        void play();
+        void pause();
+        void reverse();
+        void setSpeed(double value);
+        void seek(double time);
+        std::chrono::steady_clock::duration until(double time) const;
+
+    private:
+        void rebase();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double origin = 0;
+        double speed = 1;
+        bool running = false;
+        bool forwards = true;
+};
+
+// Current sample of every user at a playback time. Samples are read straight out of the trace columns
+class playback
+{
+    public:
+        playback(const std::vector<userTrace> &traces);
+        bool seek(double time);
+        double nextChange(bool forward) const;
+        const std::vector<locationEntry>& current() const;
+        const std::vector<size_t>& changed() const;
+
+    private:
+        const std::vector<userTrace> &traces;
+        std::vector<size_t> position;          // Number of samples of each user at or before the playback time
+        std::vector<locationEntry> samples;    // Last sample of each user at or before the playback time
+        std::vector<size_t> changedUsers;      // Users whose sample changed in the last seek
+};
+
+double playbackClock::now() const
+{
+    if(!running)
+        return origin;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * speed;
+    return forwards ? origin + elapsed : origin - elapsed;
+}
+
+bool playbackClock::playing() const
+{
+    return running;
+}
+
+bool playbackClock::forward() const
+{
+    return forwards;
+}
+
+double playbackClock::getSpeed() const
+{
+    return speed;
+}
+
+/*
+*   Input: Nothing
+*   Output: Nothing
+*   Description: Folds the time played so far into the origin so speed and direction changes only affect what comes next
+*/
+void playbackClock::rebase()
+{
+    origin = now();
+    start = std::chrono::steady_clock::now();
+}
+
+void playbackClock::play()
+{
+    rebase();
+    running = true;
+}
+
+void playbackClock::pause()
+{
+    rebase();
+    running = false;
+}
+
+void playbackClock::reverse()
+{
+    rebase();
+    forwards = !forwards;
+}
+
+void playbackClock::setSpeed(double value)
+{
+    rebase();
+    speed = value;
+}
+
+void playbackClock::seek(double time)
+{
+    rebase();
+    origin = time;
+}
+
+/*
+*   Input: Playback time
+*   Output: Real time left until playback reaches that time, zero if it already has and the largest duration if it never will
+*/
+std::chrono::steady_clock::duration playbackClock::until(double time) const
+{
+    if(!running || time == std::numeric_limits<double>::infinity() || time == -std::numeric_limits<double>::infinity())
+        return std::chrono::steady_clock::duration::max();
+
+    double seconds = (forwards ? time - now() : now() - time) / speed;
+    if(seconds <= 0)
+        return std::chrono::steady_clock::duration::zero();
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+/*
+*   Input: Trace of every user, which must outlive the playback
+*   Output: Playback positioned before the first sample of every user
+*/
+playback::playback(const std::vector<userTrace> &traces) : traces(traces), position(traces.size(), 0), samples(traces.size())
+{
+    for(size_t i = 0; i < traces.size(); i++)
+        if(!std::is_sorted(traces[i].timestamp(), traces[i].timestamp() + traces[i].size()))
+            std::cerr << "Timestamps of user " << i + 1 << " are out of order, playback of that user will skip samples" << std::endl;
+}
+
+/*
+*   Input: Playback time
+*   Output: Whether or not the current sample of any user changed
+*   Description: Binary searches every users timestamps, so a jump costs the same as a single step in either direction
+*/
+bool playback::seek(double time)
+{
+    changedUsers.clear();
+    for(size_t i = 0; i < traces.size(); i++)
+    {
+        const double *timestamp = traces[i].timestamp();
+        size_t count = std::upper_bound(timestamp, timestamp + traces[i].size(), time) - timestamp;
+        if(count == position[i])
+            continue;
+
+        position[i] = count;
+        samples[i] = count > 0 ? traces[i].entry(count - 1) : locationEntry();
+        changedUsers.push_back(i);
+    }
+    return !changedUsers.empty();
+}
+
+/*
+*   Input: Direction of playback
+*   Output: The nearest playback time at which the current sample of some user changes, infinite if none ever will
+*/
+double playback::nextChange(bool forward) const
+{
+    double next = forward ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+    for(size_t i = 0; i < traces.size(); i++)
+    {
+        const double *timestamp = traces[i].timestamp();
+        if(forward && position[i] < traces[i].size())
+            next = std::min(next, timestamp[position[i]]);
+        else if(!forward && position[i] > 0)
+            next = std::max(next, timestamp[position[i] - 1]);
+    }
+    return next;
+}
+
+/*
+*   Input: Nothing
+*   Output: Last sample of every user at or before the playback time, a blank entry (timestamp -1) before the first one
+*/
+const std::vector<locationEntry>& playback::current() const
+{
+    return samples;
+}
+
+/*
+*   Input: Nothing
+*   Output: Index of every user whose current sample changed in the last call to seek(), ascending
+*/
+const std::vector<size_t>& playback::changed() const
+{
+    return changedUsers;
+}
+
+#endif
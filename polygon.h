@@ -0,0 +1,166 @@
+#ifndef POLYGON_SRC
+#define POLYGON_SRC
+
+#include <vector>
+#include <stddef.h>
+#include "profile.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Outline of every building polygon stored as flat structure of arrays
+// Ring i is stored in lat/lon from offset[i] up to offset[i + 1] and is always closed (last vertex == first vertex)
+// Buildings without an outline have an empty ring so indices line up with Map::getBuildings()
+struct polygonSet {
+    std::vector<double> lat;
+    std::vector<double> lon;
+    std::vector<size_t> offset{0};
+
+    size_t size() const { return offset.size() - 1; }
+    size_t vertexCount(size_t i) const { return offset[i + 1] - offset[i]; }
+};
+
+/*
+* Input: First and second vertex of an edge, point
+* Output: Contribution of the edge to the winding number of the point (+1 upward crossing, -1 downward crossing)
+* Description: Upward edges count when the point is strictly left of them, downward edges when it is strictly right.
+*              The two cross products are compared rather than subtracted, so the compiler cannot fuse them into an
+*              fma on some paths and not others, and every path gives the same answer for points on an edge
+*/
+inline int windingEdge(double aLat, double aLon, double bLat, double bLon, double lat, double lon)
+{
+    double left = (bLon - aLon) * (lat - aLat);
+    double right = (lon - aLon) * (bLat - aLat);
+    if(aLat <= lat){
+        if(bLat > lat && left > right)
+            return 1;
+    }else if(bLat <= lat && left < right){
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* Input: Closed ring of n vertices as separate latitude and longitude arrays, point latitude and longitude
+* Output: Winding number of the ring around the point
+* Description: Integer winding number test with no trigonometry, one edge at a time
+*/
+inline int windingNumberScalar(const double *lat, const double *lon, size_t n, double pLat, double pLon)
+{
+    int wn = 0;
+    for(size_t i = 0; i + 1 < n; i++)
+        wn += windingEdge(lat[i], lon[i], lat[i + 1], lon[i + 1], pLat, pLon);
+    return wn;
+}
+
+#if defined(__SSE2__)
+/*
+* Input: Closed ring of n vertices as separate latitude and longitude arrays, point latitude and longitude
+* Output: Winding number of the ring around the point
+* Description: Same test as windingNumberScalar two edges per iteration, with the scalar loop for the last edge
+*/
+inline int windingNumberSSE2(const double *lat, const double *lon, size_t n, double pLat, double pLon)
+{
+    int wn = 0;
+    size_t i = 0;
+    size_t edges = n > 0 ? n - 1 : 0;
+
+    __m128d py = _mm_set1_pd(pLat);
+    __m128d px = _mm_set1_pd(pLon);
+    for(; i + 2 <= edges; i += 2){
+        __m128d ay = _mm_loadu_pd(lat + i);
+        __m128d ax = _mm_loadu_pd(lon + i);
+        __m128d by = _mm_loadu_pd(lat + i + 1);
+        __m128d bx = _mm_loadu_pd(lon + i + 1);
+
+        __m128d left = _mm_mul_pd(_mm_sub_pd(bx, ax), _mm_sub_pd(py, ay));
+        __m128d right = _mm_mul_pd(_mm_sub_pd(px, ax), _mm_sub_pd(by, ay));
+        __m128d aBelow = _mm_cmple_pd(ay, py);
+        __m128d bBelow = _mm_cmple_pd(by, py);
+
+        __m128d up = _mm_and_pd(_mm_andnot_pd(bBelow, aBelow), _mm_cmpgt_pd(left, right));
+        __m128d down = _mm_and_pd(_mm_andnot_pd(aBelow, bBelow), _mm_cmplt_pd(left, right));
+
+        wn += __builtin_popcount(_mm_movemask_pd(up)) - __builtin_popcount(_mm_movemask_pd(down));
+    }
+
+    for(; i < edges; i++)
+        wn += windingEdge(lat[i], lon[i], lat[i + 1], lon[i + 1], pLat, pLon);
+
+    return wn;
+}
+
+// The AVX2 kernel is compiled for every x86 build so ./Bench polygon can check it against the other paths, it is only
+// used by windingNumber when the build targets AVX2 and must not be called on a cpu without it
+#define POLYGON_AVX2
+
+/*
+* Input: Closed ring of n vertices as separate latitude and longitude arrays, point latitude and longitude
+* Output: Winding number of the ring around the point
+* Description: Same test as windingNumberScalar four edges per iteration, with the scalar loop for the last edges
+*/
+__attribute__((target("avx2")))
+inline int windingNumberAVX2(const double *lat, const double *lon, size_t n, double pLat, double pLon)
+{
+    int wn = 0;
+    size_t i = 0;
+    size_t edges = n > 0 ? n - 1 : 0;
+
+    __m256d py = _mm256_set1_pd(pLat);
+    __m256d px = _mm256_set1_pd(pLon);
+    for(; i + 4 <= edges; i += 4){
+        __m256d ay = _mm256_loadu_pd(lat + i);
+        __m256d ax = _mm256_loadu_pd(lon + i);
+        __m256d by = _mm256_loadu_pd(lat + i + 1);
+        __m256d bx = _mm256_loadu_pd(lon + i + 1);
+
+        __m256d left = _mm256_mul_pd(_mm256_sub_pd(bx, ax), _mm256_sub_pd(py, ay));
+        __m256d right = _mm256_mul_pd(_mm256_sub_pd(px, ax), _mm256_sub_pd(by, ay));
+        __m256d aBelow = _mm256_cmp_pd(ay, py, _CMP_LE_OQ);
+        __m256d bBelow = _mm256_cmp_pd(by, py, _CMP_LE_OQ);
+
+        __m256d up = _mm256_and_pd(_mm256_andnot_pd(bBelow, aBelow), _mm256_cmp_pd(left, right, _CMP_GT_OQ));
+        __m256d down = _mm256_and_pd(_mm256_andnot_pd(aBelow, bBelow), _mm256_cmp_pd(left, right, _CMP_LT_OQ));
+
+        wn += __builtin_popcount(_mm256_movemask_pd(up)) - __builtin_popcount(_mm256_movemask_pd(down));
+    }
+
+    for(; i < edges; i++)
+        wn += windingEdge(lat[i], lon[i], lat[i + 1], lon[i + 1], pLat, pLon);
+
+    return wn;
+}
+#endif
+
+/*
+* Input: Closed ring of n vertices as separate latitude and longitude arrays, point latitude and longitude
+* Output: Winding number of the ring around the point
+* Description: Uses the widest kernel the build targets, every path produces exactly the same counts
+*/
+inline int windingNumber(const double *lat, const double *lon, size_t n, double pLat, double pLon)
+{
+#if defined(__AVX2__)
+    return windingNumberAVX2(lat, lon, n, pLat, pLon);
+#elif defined(__SSE2__)
+    return windingNumberSSE2(lat, lon, n, pLat, pLon);
+#else
+    return windingNumberScalar(lat, lon, n, pLat, pLon);
+#endif
+}
+
+/*
+* Input: Polygon set, index of the polygon, point latitude and longitude
+* Output: Whether or not the point lies inside the polygon
+*/
+inline bool pointInPolygon(const polygonSet &polygons, size_t index, double lat, double lon)
+{
+    size_t start = polygons.offset[index];
+    size_t n = polygons.vertexCount(index);
+    if(n < 4)
+        return false;
+    PROFILE_COUNT(PROFILE_POLYGON_EDGES, n - 1);
+    return windingNumber(&polygons.lat[start], &polygons.lon[start], n, lat, lon) != 0;
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef PROFILE_SRC
+#define PROFILE_SRC
+
+// Hot path counters and scoped timers, only compiled in when NAVISENS_PROFILE is defined (make PROFILE=-DNAVISENS_PROFILE)
+// Without it every PROFILE_ macro expands to nothing and its arguments are never evaluated
+
+// Events counted in the hot paths
+enum profileCounter {
+    PROFILE_CSV_LINES,        // Log lines parsed into entries
+    PROFILE_OSM_NODES,        // Nodes handed to the node handler
+    PROFILE_OSM_WAYS,         // Ways handed to the way handlers
+    PROFILE_TILE_TESTS,       // Locations checked against the users tiles
+    PROFILE_POLYGON_EDGES,    // Polygon edges tested by point in polygon
+    PROFILE_CACHE_HITS,       // Lookups answered by an lruCache
+    PROFILE_CACHE_MISSES,
+    PROFILE_BYTES_WRITTEN,    // Bytes of output formatted by bufferedWriter, before compression
+    PROFILE_COUNTERS
+};
+
+// Timed phases, a phase can be timed on several threads at once and its time is summed over them
+enum profileTimer {
+    PROFILE_PARSE_LOG,
+    PROFILE_GATHER_NODES,
+    PROFILE_LOAD_SNAPSHOT,
+    PROFILE_BUILD_INDEXES,
+    PROFILE_VISITS,
+    PROFILE_MAP_MATCH,
+    PROFILE_DRIFT,
+    PROFILE_OUTPUT,
+    PROFILE_TIMERS
+};
+
+#ifdef NAVISENS_PROFILE
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Name of the report written at exit, can be changed with the NAVISENS_PROFILE_OUTPUT environment variable
+#define PROFILE_REPORT "profile.json"
+
+static const char *profileCounterNames[PROFILE_COUNTERS] = {"csv lines", "osm nodes", "osm ways", "tile tests",
+                                                            "polygon edges", "cache hits", "cache misses", "bytes written"};
+static const char *profileTimerNames[PROFILE_TIMERS] = {"parse log", "gather nodes", "load snapshot", "build indexes",
+                                                        "visits", "map match", "drift", "output"};
+
+// Counters and timers of a single thread. Only the owning thread writes to it, so updating it never needs a lock
+struct profileCounts {
+    uint64_t counters[PROFILE_COUNTERS] = {};
+    uint64_t calls[PROFILE_TIMERS] = {};
+    uint64_t nanoseconds[PROFILE_TIMERS] = {};
+};
+
+// Every thread's counts, kept until exit so threads that have already finished still show up in the report
+class profileRegistry
+{
+    public:
+        ~profileRegistry();
+        profileCounts* add();
+
+    private:
+        std::mutex lock;
+        std::vector<std::unique_ptr<profileCounts>> threads;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+inline profileRegistry& profileGlobal()
+{
+    static profileRegistry registry;
+    return registry;
+}
+
+// Created before main so the wall time covers the whole run and the report is written after every other static is gone
+static profileRegistry &profileStart = profileGlobal();
+
+/*
+*   Input: Nothing
+*   Output: Counts of the calling thread, registered the first time the thread counts anything
+*/
+inline profileCounts& profileThread()
+{
+    thread_local profileCounts *counts = profileGlobal().add();
+    return *counts;
+}
+
+inline profileCounts* profileRegistry::add()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    threads.push_back(std::unique_ptr<profileCounts>(new profileCounts));
+    return threads.back().get();
+}
+
+/*
+*   Input: Stream to write to, counts of one thread or the total of every thread, indentation
+*   Output: Nothing
+*/
+inline void profileWriteCounts(FILE *file, const profileCounts &counts, const char *indent)
+{
+    fprintf(file, "%s\"counters\": {", indent);
+    for(int i = 0; i < PROFILE_COUNTERS; i++)
+        fprintf(file, "%s\"%s\": %llu", i == 0 ? "" : ", ", profileCounterNames[i],
+                static_cast<unsigned long long>(counts.counters[i]));
+    fprintf(file, "},\n%s\"timers\": {", indent);
+    for(int i = 0; i < PROFILE_TIMERS; i++)
+        fprintf(file, "%s\"%s\": {\"calls\": %llu, \"seconds\": %.9f}", i == 0 ? "" : ", ", profileTimerNames[i],
+                static_cast<unsigned long long>(counts.calls[i]), counts.nanoseconds[i] * 1e-9);
+    fprintf(file, "}");
+}
+
+/*
+*   Input: Nothing
+*   Output: The report, with the total of every thread followed by each thread in the order it first counted something
+*   Description: Runs when the program exits, after every worker thread has been joined
+*/
+inline profileRegistry::~profileRegistry()
+{
+    const char *filename = getenv("NAVISENS_PROFILE_OUTPUT");
+    if(!filename)
+        filename = PROFILE_REPORT;
+
+    FILE *file = fopen(filename, "w");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open %s\n", filename);
+        return;
+    }
+
+    profileCounts total;
+    for(auto& counts : threads)
+    {
+        for(int i = 0; i < PROFILE_COUNTERS; i++)
+            total.counters[i] += counts->counters[i];
+        for(int i = 0; i < PROFILE_TIMERS; i++)
+        {
+            total.calls[i] += counts->calls[i];
+            total.nanoseconds[i] += counts->nanoseconds[i];
+        }
+    }
+
+    fprintf(file, "{\"wall seconds\": %.6f, \"thread count\": %zu,\n",
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), threads.size());
+    profileWriteCounts(file, total, " ");
+    fprintf(file, ",\n \"threads\": [");
+    for(size_t t = 0; t < threads.size(); t++)
+    {
+        fprintf(file, "%s\n  {\"thread\": %zu,\n", t == 0 ? "" : ",", t);
+        profileWriteCounts(file, *threads[t], "   ");
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+
+    if(fclose(file) != 0)
+        fprintf(stderr, "Could not write %s\n", filename);
+    else
+        fprintf(stderr, "Profile written to %s\n", filename);
+}
+
+// Adds the time between its construction and destruction to a timer of the calling thread
+class profileScope
+{
+    public:
+        profileScope(profileTimer timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+        ~profileScope()
+        {
+            profileCounts &counts = profileThread();
+            counts.calls[timer]++;
+            counts.nanoseconds[timer] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+        profileScope(const profileScope&) = delete;
+        profileScope& operator=(const profileScope&) = delete;
+
+    private:
+        profileTimer timer;
+        std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_JOIN_NAME(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_JOIN_NAME(a, b)
+#define PROFILE_COUNT(counter, amount) (profileThread().counters[counter] += (amount))
+#define PROFILE_SCOPE(timer) profileScope PROFILE_NAME(profileScope, __LINE__)(timer)
+
+#else
+
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_SCOPE(timer) ((void)0)
+
+#endif
+
+#endif
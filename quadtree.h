@@ -0,0 +1,314 @@
+#ifndef QUADTREE_SRC
+#define QUADTREE_SRC
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/geom/tile.hpp>
+#include "tiles.h"
+
+// Largest number of buildings and nodes a tile may hold before it is split into its four children
+#define QUADTREE_CAPACITY 256
+
+// Levels above the chosen zoom sparse tiles are merged up to, and below it dense tiles may be split down to
+#define QUADTREE_MERGE 2
+#define QUADTREE_SPLIT 4
+
+// Hierarchical tiling of the buildings and nodes of a Map. Top level tiles are QUADTREE_MERGE levels coarser than the
+// chosen zoom and a tile is only split while it holds more than QUADTREE_CAPACITY objects, so sparse suburbs end up in a
+// few large tiles and dense downtowns in many small ones. Every object is listed in each leaf its bounding box overlaps
+class tileTree
+{
+    public:
+        static constexpr uint32_t NO_LEAF = UINT32_MAX;
+
+        void build(uint32_t zoom, const std::vector<osmium::object_id_type> &nodeIds,
+                   const std::vector<osmium::Location> &nodeLocations, const std::vector<osmium::Box> &buildingBoxes);
+        uint32_t find(const osmium::Location &loc) const;
+        void neighbours(uint32_t leaf, std::vector<uint32_t> &result) const;
+        osmium::geom::Tile tile(uint32_t leaf) const{
+            const quadCell &cell = cells[leafCell[leaf]];
+            return osmium::geom::Tile(cell.z, cell.x, cell.y);
+        }
+        const size_t* buildings(uint32_t leaf) const{
+            return leafBuildings.data() + leafBuildingOffset[leaf];
+        }
+        uint32_t buildingCount(uint32_t leaf) const{
+            return leafBuildingOffset[leaf + 1] - leafBuildingOffset[leaf];
+        }
+        const osmium::object_id_type* nodes(uint32_t leaf) const{
+            return leafNodes.data() + leafNodeOffset[leaf];
+        }
+        uint32_t nodeCount(uint32_t leaf) const{
+            return leafNodeOffset[leaf + 1] - leafNodeOffset[leaf];
+        }
+        size_t leafCount() const{
+            return leafCell.size();
+        }
+        uint32_t deepest() const;
+
+    private:
+        // A tile of the tree, its four children are stored one after another starting at child
+        struct quadCell {
+            uint32_t z, x, y;
+            uint32_t child;       // NO_LEAF for a leaf
+            uint32_t leaf;        // Index of the leaf's contents, NO_LEAF for a tile that was split
+        };
+
+        // Position of every object at the finest zoom, only needed while the tree is built
+        struct quadItems {
+            const std::vector<osmium::object_id_type> *ids;
+            std::vector<uint32_t> nodeX, nodeY;
+            std::vector<uint32_t> minX, maxX, minY, maxY;
+        };
+
+        void fill(uint32_t cell, const quadItems &items, const std::vector<uint32_t> &nodeItems,
+                  const std::vector<uint32_t> &buildingItems);
+        bool overlaps(const quadItems &items, uint32_t building, uint32_t z, uint32_t x, uint32_t y) const;
+        void edgeLeaves(uint32_t cell, uint32_t z, uint32_t x, uint32_t y, int dx, int dy, std::vector<uint32_t> &result) const;
+
+        uint32_t coarsest = 0;
+        uint32_t finest = 0;
+        std::vector<quadCell> cells;
+        std::unordered_map<uint64_t, uint32_t> roots;                  // Tile key at the coarsest zoom -> cell
+        std::vector<uint32_t> leafCell;                                // Leaf -> cell
+        std::vector<uint32_t> leafBuildingOffset{0};                   // Leaf i -> leafBuildings[offset[i]...offset[i + 1]]
+        std::vector<size_t> leafBuildings;
+        std::vector<uint32_t> leafNodeOffset{0};
+        std::vector<osmium::object_id_type> leafNodes;
+};
+
+/*
+*   Input: Zoom the users tiles were chosen at, every node id (ascending) with its location and the bounding box of every
+*          building, a box that is not valid for buildings without a location
+*   Output: Nothing
+*   Description: Starts from the tiles at the coarsest zoom that hold anything and splits them top down, so the contents
+*                of every leaf stay in the same ascending order as the input
+*/
+void tileTree::build(uint32_t zoom, const std::vector<osmium::object_id_type> &nodeIds,
+                     const std::vector<osmium::Location> &nodeLocations, const std::vector<osmium::Box> &buildingBoxes)
+{
+    coarsest = zoom > QUADTREE_MERGE ? zoom - QUADTREE_MERGE : 0;
+    finest = std::min<uint32_t>(zoom + QUADTREE_SPLIT, MAX_ZOOM);
+    cells.clear();
+    roots.clear();
+    leafCell.clear();
+    leafBuildingOffset.assign(1, 0);
+    leafBuildings.clear();
+    leafNodeOffset.assign(1, 0);
+    leafNodes.clear();
+
+    quadItems items;
+    items.ids = &nodeIds;
+    for(auto& loc : nodeLocations){
+        osmium::geom::Tile tile(finest, loc);
+        items.nodeX.push_back(tile.x);
+        items.nodeY.push_back(tile.y);
+    }
+
+    // Tile y grows southwards, so the north west corner has the smallest x and y
+    for(auto& box : buildingBoxes){
+        if(!box.valid()){
+            items.minX.push_back(1);
+            items.maxX.push_back(0);
+            items.minY.push_back(1);
+            items.maxY.push_back(0);
+            continue;
+        }
+        osmium::geom::Tile first(finest, osmium::Location(box.bottom_left().lon(), box.top_right().lat()));
+        osmium::geom::Tile last(finest, osmium::Location(box.top_right().lon(), box.bottom_left().lat()));
+        items.minX.push_back(first.x);
+        items.maxX.push_back(last.x);
+        items.minY.push_back(first.y);
+        items.maxY.push_back(last.y);
+    }
+
+    std::unordered_map<uint64_t, std::pair<std::vector<uint32_t>, std::vector<uint32_t>>> top;
+    uint32_t shift = finest - coarsest;
+    for(uint32_t i = 0; i < items.nodeX.size(); i++)
+        top[tileKey(osmium::geom::Tile(coarsest, items.nodeX[i] >> shift, items.nodeY[i] >> shift))].first.push_back(i);
+    for(uint32_t i = 0; i < items.minX.size(); i++){
+        if(items.minX[i] > items.maxX[i])
+            continue;
+        for(uint32_t x = items.minX[i] >> shift; x <= items.maxX[i] >> shift; x++)
+            for(uint32_t y = items.minY[i] >> shift; y <= items.maxY[i] >> shift; y++)
+                top[tileKey(osmium::geom::Tile(coarsest, x, y))].second.push_back(i);
+    }
+
+    // Visit the top level tiles in key order so the same map always gives the same tree
+    std::vector<uint64_t> keys;
+    for(auto& entry : top)
+        keys.push_back(entry.first);
+    sort( keys.begin(), keys.end() );
+
+    for(auto& key : keys){
+        uint32_t cell = cells.size();
+        cells.push_back(quadCell{coarsest, static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), NO_LEAF, NO_LEAF});
+        roots[key] = cell;
+        fill(cell, items, top[key].first, top[key].second);
+    }
+}
+
+/*
+*   Input: Building, tile
+*   Output: Whether or not the bounding box of the building overlaps the tile
+*/
+bool tileTree::overlaps(const quadItems &items, uint32_t building, uint32_t z, uint32_t x, uint32_t y) const
+{
+    uint32_t shift = finest - z;
+    return items.minX[building] >> shift <= x && x <= items.maxX[building] >> shift &&
+           items.minY[building] >> shift <= y && y <= items.maxY[building] >> shift;
+}
+
+/*
+*   Input: Cell to fill, the nodes and buildings inside it
+*   Output: Nothing
+*   Description: Makes the cell a leaf holding the objects, or splits it into four children when it holds too many
+*/
+void tileTree::fill(uint32_t cell, const quadItems &items, const std::vector<uint32_t> &nodeItems,
+                    const std::vector<uint32_t> &buildingItems)
+{
+    quadCell current = cells[cell];
+    size_t total = nodeItems.size() + buildingItems.size();
+
+    if(current.z < finest && total > QUADTREE_CAPACITY){
+        std::vector<uint32_t> childNodes[4], childBuildings[4];
+        uint32_t shift = finest - current.z - 1;
+        for(auto& node : nodeItems)
+            childNodes[((items.nodeX[node] >> shift) & 1) | (((items.nodeY[node] >> shift) & 1) << 1)].push_back(node);
+        for(auto& building : buildingItems)
+            for(uint32_t c = 0; c < 4; c++)
+                if(overlaps(items, building, current.z + 1, 2 * current.x + (c & 1), 2 * current.y + (c >> 1)))
+                    childBuildings[c].push_back(building);
+
+        // Buildings covering the whole tile land in every child, splitting only helps if some child ends up smaller
+        size_t largest = 0;
+        for(uint32_t c = 0; c < 4; c++)
+            largest = std::max(largest, childNodes[c].size() + childBuildings[c].size());
+
+        if(largest < total){
+            uint32_t first = cells.size();
+            cells[cell].child = first;
+            for(uint32_t c = 0; c < 4; c++)
+                cells.push_back(quadCell{current.z + 1, 2 * current.x + (c & 1), 2 * current.y + (c >> 1), NO_LEAF, NO_LEAF});
+            for(uint32_t c = 0; c < 4; c++)
+                fill(first + c, items, childNodes[c], childBuildings[c]);
+            return;
+        }
+    }
+
+    cells[cell].leaf = leafCell.size();
+    leafCell.push_back(cell);
+    for(auto& building : buildingItems)
+        leafBuildings.push_back(building);
+    leafBuildingOffset.push_back(leafBuildings.size());
+    for(auto& node : nodeItems)
+        leafNodes.push_back((*items.ids)[node]);
+    leafNodeOffset.push_back(leafNodes.size());
+}
+
+/*
+*   Input: Location
+*   Output: Leaf the location falls in, NO_LEAF when the tree holds nothing there
+*/
+uint32_t tileTree::find(const osmium::Location &loc) const
+{
+    if(cells.empty() || !loc.valid())
+        return NO_LEAF;
+
+    osmium::geom::Tile tile(finest, loc);
+    uint32_t shift = finest - coarsest;
+    auto root = roots.find(tileKey(osmium::geom::Tile(coarsest, tile.x >> shift, tile.y >> shift)));
+    if(root == roots.end())
+        return NO_LEAF;
+
+    uint32_t cell = root->second;
+    while(cells[cell].child != NO_LEAF){
+        shift = finest - cells[cell].z - 1;
+        cell = cells[cell].child + (((tile.x >> shift) & 1) | (((tile.y >> shift) & 1) << 1));
+    }
+    return cells[cell].leaf;
+}
+
+/*
+*   Input: Leaf, vector to hold the result
+*   Output: Every other leaf that shares an edge or a corner with it, ascending
+*   Description: Neighbours can be larger than the leaf, the same size or split into several smaller leaves of which only
+*                the ones along the shared edge count. Tiles wrap around at the antimeridian but stop at the poles
+*/
+void tileTree::neighbours(uint32_t leaf, std::vector<uint32_t> &result) const
+{
+    result.clear();
+    const quadCell &cell = cells[leafCell[leaf]];
+    uint32_t count = 1u << cell.z;
+
+    for(int dy = -1; dy <= 1; dy++){
+        if((dy < 0 && cell.y == 0) || (dy > 0 && cell.y + 1 == count))
+            continue;
+        for(int dx = -1; dx <= 1; dx++){
+            if(dx == 0 && dy == 0)
+                continue;
+            uint32_t x = (cell.x + count + dx) % count;
+            uint32_t y = cell.y + dy;
+
+            // Walk down to the tile of the same size, stopping early at a larger leaf
+            uint32_t shift = cell.z - coarsest;
+            auto root = roots.find(tileKey(osmium::geom::Tile(coarsest, x >> shift, y >> shift)));
+            if(root == roots.end())
+                continue;
+            uint32_t next = root->second;
+            while(cells[next].z < cell.z && cells[next].child != NO_LEAF){
+                shift = cell.z - cells[next].z - 1;
+                next = cells[next].child + (((x >> shift) & 1) | (((y >> shift) & 1) << 1));
+            }
+            edgeLeaves(next, cell.z, x, y, dx, dy, result);
+        }
+    }
+
+    sort( result.begin(), result.end() );
+    result.erase( unique( result.begin(), result.end() ), result.end() );
+    result.erase( std::remove(result.begin(), result.end(), leaf), result.end() );
+}
+
+/*
+*   Input: Cell covering the neighbouring tile (z, x, y), which side of the leaf that tile is on, vector to add to
+*   Output: Nothing
+*   Description: Adds the leaves under the cell that touch the leaf. A neighbour to the west (dx < 0) touches along its
+*                eastern edge, one to the north (dy < 0) along its southern edge and so on
+*/
+void tileTree::edgeLeaves(uint32_t cell, uint32_t z, uint32_t x, uint32_t y, int dx, int dy, std::vector<uint32_t> &result) const
+{
+    if(cells[cell].child == NO_LEAF){
+        result.push_back(cells[cell].leaf);
+        return;
+    }
+
+    for(uint32_t c = 0; c < 4; c++){
+        const quadCell &child = cells[cells[cell].child + c];
+        uint32_t shift = child.z - z;
+        if((dx < 0 && child.x != ((x + 1) << shift) - 1) || (dx > 0 && child.x != x << shift))
+            continue;
+        if((dy < 0 && child.y != ((y + 1) << shift) - 1) || (dy > 0 && child.y != y << shift))
+            continue;
+        edgeLeaves(cells[cell].child + c, z, x, y, dx, dy, result);
+    }
+}
+
+/*
+*   Input: Nothing
+*   Output: Zoom of the smallest leaf
+*/
+uint32_t tileTree::deepest() const
+{
+    uint32_t zoom = 0;
+    for(auto& cell : leafCell)
+        zoom = std::max(zoom, cells[cell].z);
+    return zoom;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef QUERYWORKER_SRC
+#define QUERYWORKER_SRC
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "data.h"
+#include "map.h"
+#include "tiles.h"
+#include "spscqueue.h"
+
+// Number of position updates (and results) that can be waiting between the playback thread and the query worker
+#define QUERY_QUEUE 1024
+
+// Times the worker checks an empty queue before it starts sleeping between checks
+#define QUERY_SPIN 256
+#define QUERY_IDLE std::chrono::microseconds(500)
+
+// New sample of a single user, sent to the query worker
+struct positionUpdate {
+    uint32_t user;
+    locationEntry entry;
+};
+
+// What the map knows about the location of a position update
+struct queryResult {
+    uint32_t user;
+    locationEntry entry;
+    size_t buildings = 0;     // Buildings in the same tile as the user
+    size_t highways = 0;      // Highways within HIGHWAY_RADIUS of the user
+    uint32_t tileZ = 0;       // Leaf of the map's tile tree the user is in
+    uint32_t tileX = 0;
+    uint32_t tileY = 0;
+};
+
+// Runs map queries on a thread of its own so the thread handling window events never waits on the map
+// Updates go in and results come out through single producer/single consumer queues, so submit() and poll() may only
+// be called from one (the same) thread
+class queryWorker
+{
+    public:
+        queryWorker(Map &map, size_t capacity = QUERY_QUEUE);
+        ~queryWorker();
+        queryWorker(const queryWorker&) = delete;
+        queryWorker& operator=(const queryWorker&) = delete;
+        bool submit(uint32_t user, const locationEntry &entry);
+        bool poll(queryResult &result);
+        size_t pending() const;
+
+    private:
+        void run();
+        Map &map;
+        spscQueue<positionUpdate> updates;
+        spscQueue<queryResult> results;
+        std::atomic<bool> stopping{false};
+        size_t submitted = 0;     // Only touched by the submitting thread
+        size_t received = 0;
+        std::thread worker;
+};
+
+/*
+*   Input: Map to query, which must outlive the worker, and the size of each queue
+*   Output: Worker with its thread already running
+*/
+queryWorker::queryWorker(Map &map, size_t capacity) : map(map), updates(capacity), results(capacity)
+{
+    worker = std::thread(&queryWorker::run, this);
+}
+
+queryWorker::~queryWorker()
+{
+    stopping = true;
+    worker.join();
+}
+
+/*
+*   Input: User number and their new sample
+*   Output: Whether or not the update was queued, a full queue is never waited on so the caller should try again later
+*/
+bool queryWorker::submit(uint32_t user, const locationEntry &entry)
+{
+    positionUpdate update;
+    update.user = user;
+    update.entry = entry;
+    if(!updates.push(update))
+        return false;
+    submitted++;
+    return true;
+}
+
+/*
+*   Input: Variable to hold a result
+*   Output: Whether or not a result was ready
+*/
+bool queryWorker::poll(queryResult &result)
+{
+    if(!results.pop(result))
+        return false;
+    received++;
+    return true;
+}
+
+/*
+*   Input: Nothing
+*   Output: Number of submitted updates whose result has not been polled yet
+*/
+size_t queryWorker::pending() const
+{
+    return submitted - received;
+}
+
+/*
+*   Input: Nothing
+*   Output: Nothing
+*   Description: Answers updates in the order they were submitted until the worker is destroyed. While there is nothing
+*                to do it spins briefly and then sleeps in short steps
+*/
+void queryWorker::run()
+{
+    positionUpdate update;
+    int idle = 0;
+    while(!stopping)
+    {
+        if(!updates.pop(update))
+        {
+            if(++idle < QUERY_SPIN)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(QUERY_IDLE);
+            continue;
+        }
+        idle = 0;
+
+        queryResult result;
+        result.user = update.user;
+        result.entry = update.entry;
+
+        osmium::Location userLocation(update.entry.navLon, update.entry.navLat);
+        if(userLocation.valid())
+        {
+            osmium::geom::Tile userTile = map.getTile(userLocation);
+            result.tileZ = userTile.z;
+            result.tileX = userTile.x;
+            result.tileY = userTile.y;
+            result.buildings = map.getBuildings(userLocation)->size();
+            result.highways = map.getHighways(userLocation).size();
+        }
+
+        // Results are never dropped, wait for the playback thread to make room
+        while(!results.push(result) && !stopping)
+            std::this_thread::yield();
+    }
+}
+
+#endif
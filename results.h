@@ -0,0 +1,111 @@
+#ifndef RESULTS_SRC
+#define RESULTS_SRC
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include "data.h"
+#include "logparser.h"
+#include "snapshot.h"
+
+/*
+*  Binary occupancy result layout, written as userNbuildings.occupancy
+*  occupancyHeader
+*  entered osm ids (int64), entered kinds (uint8, OCCUPANCY_NODE or OCCUPANCY_WAY),
+*  entered centre longitudes (int32), entered centre latitudes (int32)
+*  Every column is preceded by its length as a uint64, coordinates use osmium's fixed point (1e-7 degrees)
+*/
+#define OCCUPANCY_MAGIC "NAVOCCUP"
+#define OCCUPANCY_VERSION 1
+#define OCCUPANCY_NODE 0
+#define OCCUPANCY_WAY 1
+
+struct occupancyHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t user;            // User number, the same one used in the file name
+    uint64_t buildings;       // Number of buildings the user was checked against
+};
+
+// Every building a single user entered, stored column by column
+struct occupancyResult {
+    occupancyHeader header;
+    std::vector<int64_t> id;
+    std::vector<uint8_t> kind;
+    std::vector<int32_t> lon;
+    std::vector<int32_t> lat;
+};
+
+/*
+*   Input: Every building, index of every building the user entered, user number and name of the file to write
+*   Output: Whether or not the file was written
+*   Description: Stores the osm id and the centre of each entered building, 17 bytes per building
+*/
+bool saveOccupancy(const buildingTable &buildings, const std::vector<size_t> &entered, int user, const std::string &filename)
+{
+    occupancyResult result;
+    memcpy(result.header.magic, OCCUPANCY_MAGIC, sizeof(result.header.magic));
+    result.header.version = OCCUPANCY_VERSION;
+    result.header.user = user;
+    result.header.buildings = buildings.size();
+
+    for(auto& index : entered)
+    {
+        // Centre of the bounding box of the outline, or the node itself for buildings mapped as a node
+        osmium::Location centre = buildings.location[index];
+        result.kind.push_back(centre.is_defined() ? OCCUPANCY_NODE : OCCUPANCY_WAY);
+        if(!centre.is_defined() && buildings.vertexCount(index) > 0)
+        {
+            const osmium::Location *outline = buildings.outline(index);
+            int64_t minX = outline[0].x(), maxX = minX, minY = outline[0].y(), maxY = minY;
+            for(uint32_t j = 1; j < buildings.vertexCount(index); j++)
+            {
+                minX = std::min<int64_t>(minX, outline[j].x());
+                maxX = std::max<int64_t>(maxX, outline[j].x());
+                minY = std::min<int64_t>(minY, outline[j].y());
+                maxY = std::max<int64_t>(maxY, outline[j].y());
+            }
+            centre = osmium::Location(static_cast<int32_t>((minX + maxX) / 2), static_cast<int32_t>((minY + maxY) / 2));
+        }
+
+        result.id.push_back(buildings.id[index]);
+        result.lon.push_back(centre.x());
+        result.lat.push_back(centre.y());
+    }
+
+    snapshotWriter out;
+    out.value(result.header);
+    out.array(result.id);
+    out.array(result.kind);
+    out.array(result.lon);
+    out.array(result.lat);
+    return out.save(filename);
+}
+
+/*
+*   Input: Name of an occupancy file and variable to hold its contents
+*   Output: Whether or not the file was a complete occupancy file
+*/
+bool loadOccupancy(const std::string &filename, occupancyResult &result)
+{
+    mappedFile file(filename);
+    if(!file.isOpen() || file.size() == 0)
+        return false;
+
+    snapshotReader in(file.data(), file.size());
+    if(!in.value(result.header) || memcmp(result.header.magic, OCCUPANCY_MAGIC, sizeof(result.header.magic)) != 0 ||
+       result.header.version != OCCUPANCY_VERSION)
+        return false;
+
+    in.array(result.id);
+    in.array(result.kind);
+    in.array(result.lon);
+    in.array(result.lat);
+
+    size_t n = result.id.size();
+    return in.atEnd() && result.kind.size() == n && result.lon.size() == n && result.lat.size() == n;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef SNAPSHOT_SRC
+#define SNAPSHOT_SRC
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// Appends plain values, strings and vectors to an in memory buffer that is written to disk in one go
+class snapshotWriter
+{
+    public:
+        template <typename T> void value(const T &v);
+        template <typename T> void array(const std::vector<T> &v);
+        void string(const std::string &s);
+        bool save(const std::string &filename) const;
+
+    private:
+        void write(const void *data, size_t size);
+        std::string buffer;
+};
+
+// Reads back what a snapshotWriter wrote, straight out of a memory mapped file
+// Every read fails (and keeps failing) once the end of the data is reached so a truncated file is never trusted
+class snapshotReader
+{
+    public:
+        snapshotReader(const char *data, size_t size);
+        template <typename T> bool value(T &v);
+        template <typename T> bool array(std::vector<T> &v);
+        bool string(std::string &s);
+        bool good() const;
+        bool atEnd() const;
+
+    private:
+        bool read(void *data, size_t size);
+        const char *p;
+        const char *end;
+        bool ok = true;
+};
+
+void snapshotWriter::write(const void *data, size_t size)
+{
+    buffer.append(static_cast<const char*>(data), size);
+}
+
+template <typename T>
+void snapshotWriter::value(const T &v)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+    write(&v, sizeof(T));
+}
+
+template <typename T>
+void snapshotWriter::array(const std::vector<T> &v)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must hold trivially copyable values");
+    value<uint64_t>(v.size());
+    if(!v.empty())
+        write(v.data(), v.size() * sizeof(T));
+}
+
+void snapshotWriter::string(const std::string &s)
+{
+    value<uint32_t>(s.size());
+    write(s.data(), s.size());
+}
+
+/*
+*   Input: Name of the file to write
+*   Output: Whether or not the whole buffer was written
+*   Description: Writes to a temporary file first and renames it so a reader never sees a partial snapshot
+*/
+bool snapshotWriter::save(const std::string &filename) const
+{
+    std::string tempFile = filename + ".tmp";
+    FILE *file = fopen(tempFile.c_str(), "wb");
+    if(!file)
+        return false;
+
+    bool ok = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok || rename(tempFile.c_str(), filename.c_str()) != 0){
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+snapshotReader::snapshotReader(const char *data, size_t size) : p(data), end(data + size)
+{
+}
+
+bool snapshotReader::read(void *data, size_t size)
+{
+    if(!ok || static_cast<size_t>(end - p) < size){
+        ok = false;
+        return false;
+    }
+    memcpy(data, p, size);
+    p += size;
+    return true;
+}
+
+template <typename T>
+bool snapshotReader::value(T &v)
+{
+    return read(&v, sizeof(T));
+}
+
+template <typename T>
+bool snapshotReader::array(std::vector<T> &v)
+{
+    uint64_t size;
+    if(!value(size) || static_cast<uint64_t>(end - p) / sizeof(T) < size){
+        ok = false;
+        return false;
+    }
+    v.resize(size);
+    return size == 0 || read(v.data(), size * sizeof(T));
+}
+
+bool snapshotReader::string(std::string &s)
+{
+    uint32_t size;
+    if(!value(size) || static_cast<size_t>(end - p) < size){
+        ok = false;
+        return false;
+    }
+    s.assign(p, size);
+    p += size;
+    return true;
+}
+
+bool snapshotReader::good() const
+{
+    return ok;
+}
+
+bool snapshotReader::atEnd() const
+{
+    return ok && p == end;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SPSCQUEUE_SRC
+#define SPSCQUEUE_SRC
+
+#include <vector>
+#include <atomic>
+#include <stddef.h>
+
+// Size of a cache line, the two ends of the queue are kept on separate lines so the threads never share one
+#define SPSC_CACHE_LINE 64
+
+// Fixed size lock free queue for exactly one producer thread and one consumer thread
+// Neither end ever blocks, push fails when the queue is full and pop fails when it is empty
+template <typename T>
+class spscQueue
+{
+    public:
+        spscQueue(size_t capacity);
+        spscQueue(const spscQueue&) = delete;
+        spscQueue& operator=(const spscQueue&) = delete;
+        bool push(const T &value);
+        bool pop(T &value);
+        size_t capacity() const;
+
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        alignas(SPSC_CACHE_LINE) std::atomic<size_t> head{0};  // Next slot to pop, only written by the consumer
+        size_t cachedTail = 0;                                  // Consumer's last view of tail
+        alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail{0};  // Next slot to push, only written by the producer
+        size_t cachedHead = 0;                                  // Producer's last view of head
+};
+
+/*
+*   Input: Number of values the queue must be able to hold
+*   Output: Empty queue, the capacity is rounded up to a power of two so slots can be found with a mask
+*/
+template <typename T>
+spscQueue<T>::spscQueue(size_t capacity)
+{
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+}
+
+/*
+*   Input: Value to add
+*   Output: Whether or not there was room for the value
+*   Description: Only called by the producer. The consumer's position is only re-read when the queue looks full
+*/
+template <typename T>
+bool spscQueue<T>::push(const T &value)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - cachedHead == slots.size()){
+        cachedHead = head.load(std::memory_order_acquire);
+        if(t - cachedHead == slots.size())
+            return false;
+    }
+
+    slots[t & mask] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+/*
+*   Input: Variable to hold the value
+*   Output: Whether or not there was a value to take
+*   Description: Only called by the consumer. The producer's position is only re-read when the queue looks empty
+*/
+template <typename T>
+bool spscQueue<T>::pop(T &value)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h == cachedTail){
+        cachedTail = tail.load(std::memory_order_acquire);
+        if(h == cachedTail)
+            return false;
+    }
+
+    value = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+size_t spscQueue<T>::capacity() const
+{
+    return slots.size();
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef STREAM_SRC
+#define STREAM_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "data.h"
+#include "map.h"
+#include "polygon.h"
+#include "logparser.h"
+
+// Size of the read buffer, a record never needs to be longer than this
+#define STREAM_BUFFER (1 << 16)
+
+// Everything kept about a user between records. Its size depends only on how many buildings the user is standing in
+// right now, never on how long the stream has been running
+struct streamUser {
+    std::vector<size_t> inside;   // Buildings that contained the last sample, ascending
+    double lastTimestamp = -1;    // Timestamp of the last sample, older samples arrived out of order
+};
+
+/*
+*   Input: Start and end of a record (without the newline), variables to hold the user tag and the entry
+*   Output: Whether or not the record was complete
+*   Description: Records are a user tag followed by the same seven values as a line of a user log:
+*                user,Timestamp,Nav Lat,Nav Lon,Nav Alt,GPS Lat,GPS Lon,GPS Alt
+*/
+inline bool parseRecord(const char *p, const char *end, std::string &user, locationEntry &entry)
+{
+    if(end <= p)
+        return false;
+
+    const char *comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if(!comma || comma == p)
+        return false;
+
+    user.assign(p, comma);
+    return parseLine(comma + 1, end, entry);
+}
+
+/*
+*   Input: Map object, state of the user, tagged sample and stream to write events to
+*   Output: Whether or not the sample was used, samples older than the users previous one are dropped
+*   Description: Checks the sample against the buildings around it and writes an enter event, with the osm id of the
+*                building, for every building the user was not already inside at their previous sample
+*/
+bool updateOccupancy(const Map &map, const std::string &tag, streamUser &user, const locationEntry &entry,
+                     std::vector<size_t> &candidates, std::ostream &events)
+{
+    if(entry.timestamp < user.lastTimestamp)
+        return false;
+
+    const polygonSet &polygons = map.getBuildingPolygons();
+    const buildingTable &buildings = map.getBuildings();
+
+    std::vector<size_t> inside;
+    map.getBuildingCandidates(entry.navLat, entry.navLon, user.inside, candidates);
+    for(auto& index : candidates)
+        if(pointInPolygon(polygons, index, entry.navLat, entry.navLon))
+            inside.push_back(index);
+
+    for(auto& index : inside)
+    {
+        if(!std::binary_search(user.inside.begin(), user.inside.end(), index))
+        {
+            events << "{\"event\": \"enter\", \"user\": \"" << tag << "\", \"timestamp\": " << entry.timestamp
+                   << ", \"building\": " << buildings.id[index] << ", \"lat\": " << entry.navLat << ", \"lon\": " << entry.navLon << "}\n";
+            events.flush();
+        }
+    }
+
+    user.inside.swap(inside);
+    user.lastTimestamp = entry.timestamp;
+    return true;
+}
+
+/*
+*   Input: Map object, name of a named pipe or - for stdin
+*   Output: Enter events on stdout as records arrive, one json object per line
+*   Description: Reads tagged location records until the writer closes the stream. Every complete record is handled
+*                as soon as read() returns it so an event is written at most one record after the sample that caused it
+*/
+void streamOccupancy(const Map &map, std::string source)
+{
+    int fd = 0;
+    if(source != "-")
+    {
+        fd = open(source.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            std::cerr << "Could not open " << source << ": " << strerror(errno) << std::endl;
+            return;
+        }
+    }
+
+    // Fixed point keeps the fraction of epoch timestamps, 7 decimals is the precision of osmium locations
+    std::cout << std::fixed;
+    std::cout.precision(7);
+    std::cerr << "Streaming location records from " << (source == "-" ? "stdin" : source) << std::endl;
+
+    std::unordered_map<std::string, streamUser> users;
+    std::vector<size_t> candidates;
+    std::string tag;
+    locationEntry entry;
+    uint64_t records = 0, skipped = 0, late = 0;
+
+    std::vector<char> buffer(STREAM_BUFFER);
+    size_t filled = 0;
+    while(true)
+    {
+        ssize_t count = read(fd, buffer.data() + filled, buffer.size() - filled);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            break;
+        filled += count;
+
+        // Handle every complete record in the buffer and keep the partial one at the end for the next read
+        const char *p = buffer.data();
+        const char *end = buffer.data() + filled;
+        const char *newline;
+        while((newline = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr)
+        {
+            const char *recordEnd = newline;
+            if(recordEnd > p && recordEnd[-1] == '\r')
+                recordEnd--;
+
+            if(parseRecord(p, recordEnd, tag, entry))
+            {
+                if(updateOccupancy(map, tag, users[tag], entry, candidates, std::cout))
+                    records++;
+                else
+                    late++;
+            }else if(recordEnd > p)
+                skipped++;
+            p = newline + 1;
+        }
+
+        filled = end - p;
+        memmove(buffer.data(), p, filled);
+
+        // A record that fills the whole buffer can never be completed, drop it
+        if(filled == buffer.size())
+        {
+            skipped++;
+            filled = 0;
+        }
+    }
+
+    // The last record may not end in a newline
+    if(filled > 0 && parseRecord(buffer.data(), buffer.data() + filled, tag, entry))
+    {
+        if(updateOccupancy(map, tag, users[tag], entry, candidates, std::cout))
+            records++;
+        else
+            late++;
+    }
+
+    if(fd != 0)
+        close(fd);
+
+    std::cerr << "Stream closed after " << records << " records from " << users.size() << " users (" << skipped
+              << " malformed and " << late << " out of order records skipped)" << std::endl;
+}
+
+#endif
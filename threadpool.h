@@ -0,0 +1,187 @@
+#ifndef THREADPOOL_SRC
+#define THREADPOOL_SRC
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+// Fixed size pool of worker threads that run submitted tasks in the order they were submitted
+class threadPool
+{
+    public:
+        threadPool(int workers);
+        ~threadPool();
+        void submit(std::function<void()> task);
+        void wait();
+        int size() const;
+
+    private:
+        void work();
+        std::vector<std::thread> threads;
+        std::queue<std::function<void()>> tasks;
+        std::mutex lock;
+        std::condition_variable taskReady;
+        std::condition_variable allDone;
+        int running = 0;
+        bool stopping = false;
+};
+
+/*
+*   Input: Number of worker threads, anything below 1 uses one per hardware thread
+*   Output: Pool with its workers started and waiting for tasks
+*/
+threadPool::threadPool(int workers)
+{
+    if(workers < 1)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 0; i < workers; i++)
+        threads.push_back(std::thread(&threadPool::work, this));
+}
+
+/*
+*   Description: Finishes every task that has already been submitted and joins the workers
+*/
+threadPool::~threadPool()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for(auto& t : threads)
+        t.join();
+}
+
+/*
+*   Input: Task to run
+*   Output: Nothing
+*   Description: Queues the task for the next free worker
+*/
+void threadPool::submit(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        tasks.push(std::move(task));
+    }
+    taskReady.notify_one();
+}
+
+/*
+*   Input: Nothing
+*   Output: Nothing
+*   Description: Blocks until every submitted task has finished running
+*/
+void threadPool::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    allDone.wait(guard, [this]{ return tasks.empty() && running == 0; });
+}
+
+int threadPool::size() const
+{
+    return threads.size();
+}
+
+/*
+*   Description: Worker loop, takes tasks off the queue until the pool is destroyed
+*/
+void threadPool::work()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            taskReady.wait(guard, [this]{ return stopping || !tasks.empty(); });
+            if(tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+            running++;
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            running--;
+            if(tasks.empty() && running == 0)
+                allDone.notify_all();
+        }
+    }
+}
+
+// Blocking queue with a fixed capacity, used to hand work from one thread to another
+// push blocks while the queue is full and pop blocks while it is empty until close() is called
+template <typename T>
+class boundedQueue
+{
+    public:
+        boundedQueue(size_t capacity) : capacity(capacity) {}
+        void push(T value);
+        bool pop(T &value);
+        void close();
+
+    private:
+        std::queue<T> items;
+        std::mutex lock;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+        size_t capacity;
+        bool closed = false;
+};
+
+/*
+*   Input: Value to add to the back of the queue
+*   Output: Nothing
+*   Description: Waits for space if the queue is full
+*/
+template <typename T>
+void boundedQueue<T>::push(T value)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this]{ return items.size() < capacity; });
+        items.push(std::move(value));
+    }
+    notEmpty.notify_one();
+}
+
+/*
+*   Input: Variable to hold the value taken from the front of the queue
+*   Output: False once the queue has been closed and everything in it taken
+*/
+template <typename T>
+bool boundedQueue<T>::pop(T &value)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this]{ return closed || !items.empty(); });
+        if(items.empty())
+            return false;
+        value = std::move(items.front());
+        items.pop();
+    }
+    notFull.notify_one();
+    return true;
+}
+
+/*
+*   Description: Tells the consumer that nothing more will be pushed
+*/
+template <typename T>
+void boundedQueue<T>::close()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        closed = true;
+    }
+    notEmpty.notify_all();
+}
+
+#endif
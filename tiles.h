@@ -0,0 +1,167 @@
+#ifndef TILES_SRC
+#define TILES_SRC
+
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+
+#include <osmium/osm/types.hpp>
+#include <osmium/geom/tile.hpp>
+#include "profile.h"
+
+// Default zoom of the tiles the users pass through, can be changed at runtime with --zoom
+#define ZOOM 17
+/* Zoom Value Meaning
+* 11 - City
+* 12 - Town/City District
+* 13 - Suburb
+* 14 -
+* 15 - Small Road
+* 16 - Street
+* 17 - Block/Park
+* 18 - Building/Tree
+*/
+
+// Deepest zoom osmium tiles support
+#define MAX_ZOOM 30
+
+// Largest number of tiles an area is checked against one by one, larger areas only get the bounding box test
+#define TILE_FILTER_SCAN 256
+
+// Furthest latitude web mercator tiles reach
+#define MAX_TILE_LAT 85.0511
+
+/*
+* Input: tile
+* Output: Single integer that uniquely identifies the tile among the tiles of its zoom
+* Description: Packs the x and y coordinates of a tile into one value so tiles can be used as hash keys
+*/
+inline uint64_t tileKey(const osmium::geom::Tile &tile)
+{
+    return (static_cast<uint64_t>(tile.x) << 32) | tile.y;
+}
+
+/*
+* Input: List of tiles
+* Output: The zoom, x and y of every tile one after another
+*/
+inline std::vector<uint32_t> flattenTiles(const std::vector<osmium::geom::Tile> &tiles)
+{
+    std::vector<uint32_t> values;
+    for(auto& tile : tiles){
+        values.push_back(tile.z);
+        values.push_back(tile.x);
+        values.push_back(tile.y);
+    }
+    return values;
+}
+
+/*
+* Input: Zoom level and tile x coordinate
+* Output: Longitude of the western edge of the tile
+*/
+inline double tileLon(uint32_t zoom, double x)
+{
+    return x / (1u << zoom) * 360.0 - 180.0;
+}
+
+/*
+* Input: Zoom level and tile y coordinate
+* Output: Latitude of the northern edge of the tile
+*/
+inline double tileLat(uint32_t zoom, double y)
+{
+    return atan(sinh(M_PI * (1 - 2 * y / (1u << zoom)))) * 180.0 / M_PI;
+}
+
+// Set of tiles the users pass through, answers whether or not a location falls in one of them in constant time
+// Locations outside the bounding box of every tile are rejected before the (more expensive) tile projection
+class tileFilter
+{
+    public:
+        tileFilter(const std::vector<osmium::geom::Tile> &tiles);
+        bool contains(const osmium::Location &loc) const;
+        bool overlaps(double minLon, double minLat, double maxLon, double maxLat) const;
+
+    private:
+        std::unordered_set<uint64_t> keys;
+        uint32_t zoom = ZOOM;
+        double minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+};
+
+/*
+*   Input: Tiles (all at the same zoom)
+*   Output: Filter for those tiles
+*/
+tileFilter::tileFilter(const std::vector<osmium::geom::Tile> &tiles)
+{
+    if(tiles.empty())
+        return;
+
+    zoom = tiles[0].z;
+    uint32_t minX = tiles[0].x, maxX = tiles[0].x, minY = tiles[0].y, maxY = tiles[0].y;
+    for(auto& tile : tiles){
+        keys.insert(tileKey(tile));
+        minX = std::min(minX, tile.x);
+        maxX = std::max(maxX, tile.x);
+        minY = std::min(minY, tile.y);
+        maxY = std::max(maxY, tile.y);
+    }
+
+    // Pad the box slightly so rounding never rejects a location on the edge of a tile
+    double pad = 1e-6;
+    minLon = tileLon(zoom, minX) - pad;
+    maxLon = tileLon(zoom, maxX + 1.0) + pad;
+    minLat = tileLat(zoom, maxY + 1.0) - pad;
+    maxLat = tileLat(zoom, minY) + pad;
+}
+
+/*
+*   Input: Location
+*   Output: Whether or not the location falls inside one of the tiles
+*/
+bool tileFilter::contains(const osmium::Location &loc) const
+{
+    PROFILE_COUNT(PROFILE_TILE_TESTS, 1);
+    if(keys.empty() || !loc.valid())
+        return false;
+
+    double lat = loc.lat(), lon = loc.lon();
+    if(lat < minLat || lat > maxLat || lon < minLon || lon > maxLon)
+        return false;
+
+    return keys.count(tileKey(osmium::geom::Tile(zoom, loc))) > 0;
+}
+
+/*
+*   Input: Corners of an area
+*   Output: Whether or not the area may overlap one of the tiles
+*   Description: Exact for areas covering up to TILE_FILTER_SCAN tiles, larger areas that meet the bounding box of the
+*                tiles are assumed to overlap them
+*/
+bool tileFilter::overlaps(double minLon, double minLat, double maxLon, double maxLat) const
+{
+    if(keys.empty() || maxLat < this->minLat || minLat > this->maxLat || maxLon < this->minLon || minLon > this->maxLon)
+        return false;
+
+    minLat = std::max(minLat, -MAX_TILE_LAT);
+    maxLat = std::min(maxLat, MAX_TILE_LAT);
+    minLon = std::max(minLon, -180.0);
+    maxLon = std::min(maxLon, 180.0);
+
+    // Tile y grows southwards
+    osmium::geom::Tile first(zoom, osmium::Location(minLon, maxLat));
+    osmium::geom::Tile last(zoom, osmium::Location(maxLon, minLat));
+    if(static_cast<uint64_t>(last.x - first.x + 1) * (last.y - first.y + 1) > TILE_FILTER_SCAN)
+        return true;
+
+    for(uint32_t x = first.x; x <= last.x; x++)
+        for(uint32_t y = first.y; y <= last.y; y++)
+            if(keys.count(tileKey(osmium::geom::Tile(zoom, x, y))) > 0)
+                return true;
+    return false;
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef TRACE_SRC
+#define TRACE_SRC
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <iostream>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "data.h"
+#include "logparser.h"
+
+/*
+*  Binary trace cache layout, written next to the csv file as <csv>.trace
+*  traceHeader
+*  count timestamps, count nav latitudes, count nav longitudes, count nav altitudes,
+*  count gps latitudes, count gps longitudes, count gps altitudes (all native doubles)
+*  Samples are sorted by timestamp. Version 1 caches of single threaded runs could hold them in file order
+*/
+#define TRACE_MAGIC "NAVTRACE"
+#define TRACE_VERSION 2
+#define TRACE_COLUMNS 7
+
+struct traceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint64_t count;           // Number of samples in every column
+    uint64_t sourceSize;      // Size of the csv file the cache was built from
+    int64_t sourceModified;   // Modification time of that csv file in nanoseconds
+};
+
+// Every sample of a single user stored column by column, either memory mapped from a trace cache or held in memory
+class userTrace
+{
+    public:
+        userTrace() = default;
+        userTrace(const std::vector<locationEntry> &entries);
+        userTrace(userTrace&&) = default;
+        userTrace& operator=(userTrace&&) = default;
+        bool load(const std::string &csvFile, int workers);
+        bool save(const std::string &traceFile) const;
+        size_t size() const;
+        const double* timestamp() const;
+        const double* navLat() const;
+        const double* navLon() const;
+        const double* navAlt() const;
+        const double* gpsLat() const;
+        const double* gpsLon() const;
+        const double* gpsAlt() const;
+        locationEntry entry(size_t i) const;
+        std::vector<locationEntry> entries() const;
+
+    private:
+        bool loadCache(const std::string &traceFile, const struct stat &source);
+        void setColumns(const double *first);
+        std::unique_ptr<mappedFile> mapping;  // Backing memory when loaded from a cache
+        std::vector<double> storage;          // Backing memory when built from entries
+        const double *columns[TRACE_COLUMNS] = {};
+        size_t count = 0;
+        uint64_t sourceSize = 0;
+        int64_t sourceModified = 0;
+};
+
+/*
+*   Input: stat of a file
+*   Output: Modification time of the file in nanoseconds
+*/
+inline int64_t modifiedTime(const struct stat &info)
+{
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+/*
+*   Input: Every entry of a user log
+*   Output: Trace holding a copy of the entries column by column
+*/
+userTrace::userTrace(const std::vector<locationEntry> &entries)
+{
+    count = entries.size();
+    storage.resize(count * TRACE_COLUMNS);
+
+    double *column = storage.data();
+    for(size_t i = 0; i < count; i++){
+        column[i] = entries[i].timestamp;
+        column[count + i] = entries[i].navLat;
+        column[2 * count + i] = entries[i].navLon;
+        column[3 * count + i] = entries[i].navAlt;
+        column[4 * count + i] = entries[i].gpsLat;
+        column[5 * count + i] = entries[i].gpsLon;
+        column[6 * count + i] = entries[i].gpsAlt;
+    }
+    setColumns(storage.data());
+}
+
+/*
+*   Input: Start of the first column
+*   Output: Nothing
+*   Description: Points every column at its place in a block of TRACE_COLUMNS * count doubles
+*/
+void userTrace::setColumns(const double *first)
+{
+    for(int i = 0; i < TRACE_COLUMNS; i++)
+        columns[i] = first + i * count;
+}
+
+/*
+*   Input: Name of the csv file and number of threads to parse it with
+*   Output: Whether or not the user log could be read
+*   Description: Memory maps <csv>.trace if it was built from the current version of the csv file. Otherwise the csv is
+*                parsed and the cache is written next to it for the next run. A log with no valid line is treated as
+*                unreadable and never cached, so a later run parses it again instead of loading an empty cache
+*/
+bool userTrace::load(const std::string &csvFile, int workers)
+{
+    struct stat source;
+    if(stat(csvFile.c_str(), &source) != 0)
+        return false;
+
+    std::string traceFile = csvFile + ".trace";
+    if(loadCache(traceFile, source))
+        return true;
+
+    std::vector<locationEntry> entries;
+    if(!tokenizeLog(entries, csvFile, workers) || entries.empty())
+        return false;
+    *this = userTrace(entries);
+    sourceSize = source.st_size;
+    sourceModified = modifiedTime(source);
+
+    if(!save(traceFile))
+        std::cerr << "Could not write trace cache " << traceFile << std::endl;
+    return true;
+}
+
+/*
+*   Input: Name of the trace cache and stat of the csv file it should have been built from
+*   Output: Whether or not the cache was valid and has been mapped
+*/
+bool userTrace::loadCache(const std::string &traceFile, const struct stat &source)
+{
+    std::unique_ptr<mappedFile> file(new mappedFile(traceFile));
+    if(!file->isOpen() || file->size() < sizeof(traceHeader))
+        return false;
+
+    traceHeader header;
+    memcpy(&header, file->data(), sizeof(traceHeader));
+    if(memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION ||
+       header.columns != TRACE_COLUMNS)
+        return false;
+    if(header.sourceSize != static_cast<uint64_t>(source.st_size) || header.sourceModified != modifiedTime(source))
+        return false;
+    if(file->size() != sizeof(traceHeader) + header.count * TRACE_COLUMNS * sizeof(double))
+        return false;
+
+    mapping = std::move(file);
+    storage.clear();
+    count = header.count;
+    sourceSize = header.sourceSize;
+    sourceModified = header.sourceModified;
+    setColumns(reinterpret_cast<const double*>(mapping->data() + sizeof(traceHeader)));
+    return true;
+}
+
+/*
+*   Input: Name of the trace cache to write
+*   Output: Whether or not the cache was written
+*   Description: Writes to a temporary file first and renames it so a reader never sees a partial cache. The temporary
+*                file is named after the process so two runs on the same log never write to the same one
+*/
+bool userTrace::save(const std::string &traceFile) const
+{
+    traceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.columns = TRACE_COLUMNS;
+    header.count = count;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+
+    std::string tempFile = traceFile + "." + std::to_string(getpid()) + ".tmp";
+    FILE *file = fopen(tempFile.c_str(), "wb");
+    if(!file)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for(int i = 0; i < TRACE_COLUMNS && ok && count > 0; i++)
+        ok = fwrite(columns[i], sizeof(double), count, file) == count;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok || rename(tempFile.c_str(), traceFile.c_str()) != 0){
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t userTrace::size() const
+{
+    return count;
+}
+
+const double* userTrace::timestamp() const
+{
+    return columns[0];
+}
+
+const double* userTrace::navLat() const
+{
+    return columns[1];
+}
+
+const double* userTrace::navLon() const
+{
+    return columns[2];
+}
+
+const double* userTrace::navAlt() const
+{
+    return columns[3];
+}
+
+const double* userTrace::gpsLat() const
+{
+    return columns[4];
+}
+
+const double* userTrace::gpsLon() const
+{
+    return columns[5];
+}
+
+const double* userTrace::gpsAlt() const
+{
+    return columns[6];
+}
+
+/*
+*   Input: Sample index
+*   Output: The sample as a locationEntry
+*/
+locationEntry userTrace::entry(size_t i) const
+{
+    locationEntry temp;
+    temp.timestamp = columns[0][i];
+    temp.navLat = columns[1][i];
+    temp.navLon = columns[2][i];
+    temp.navAlt = columns[3][i];
+    temp.gpsLat = columns[4][i];
+    temp.gpsLon = columns[5][i];
+    temp.gpsAlt = columns[6][i];
+    return temp;
+}
+
+/*
+*   Input: Nothing
+*   Output: Every sample as a locationEntry, for code that still works on whole structs
+*/
+std::vector<locationEntry> userTrace::entries() const
+{
+    std::vector<locationEntry> result;
+    result.reserve(count);
+    for(size_t i = 0; i < count; i++)
+        result.push_back(entry(i));
+    return result;
+}
+
+#endif
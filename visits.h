@@ -0,0 +1,155 @@
+#ifndef VISITS_SRC
+#define VISITS_SRC
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "data.h"
+#include "map.h"
+#include "polygon.h"
+#include "trace.h"
+#include "writer.h"
+#include "profile.h"
+
+// One uninterrupted stay of a user inside a building
+struct buildingVisit {
+    size_t building;      // Index into Map::getBuildings()
+    size_t first;         // Index of the first and last samples of the trace inside the building
+    size_t last;
+    double entry;         // Timestamps of those samples
+    double exit;
+
+    double dwell() const { return exit - entry; }
+};
+
+/*
+*   Input: Map object, User locations, range of samples to check
+*   Output: Every visit of the samples in [begin, end) to a building, ordered by the sample that ended it
+*   Description: Follows the user through the range keeping the buildings that contain the current sample. A visit
+*                starts at the first sample inside a building and ends at the last one before the user leaves it.
+*                Candidates come from the coherent lookup, so a user who stays in or near the same building never
+*                touches the R-tree. Only reads from the map so any number of ranges can be checked at the same time
+*/
+std::vector<buildingVisit> getBuildingVisits(const Map &map, const userTrace &user, size_t begin, size_t end)
+{
+    PROFILE_SCOPE(PROFILE_VISITS);
+    const polygonSet &polygons = map.getBuildingPolygons();
+    const double *lat = user.navLat();
+    const double *lon = user.navLon();
+    const double *timestamp = user.timestamp();
+
+    std::vector<buildingVisit> visits;
+    std::vector<buildingVisit> open;        // Visit to every building the current sample is in, ascending
+    std::vector<buildingVisit> next;
+    std::vector<size_t> inside, candidates;
+
+    for(size_t i = begin; i < end; i++)
+    {
+        map.getBuildingCandidates(lat[i], lon[i], inside, candidates);
+
+        inside.clear();
+        next.clear();
+        size_t o = 0;
+        for(auto& index : candidates)
+        {
+            if(!pointInPolygon(polygons, index, lat[i], lon[i]))
+                continue;
+
+            // Both lists are ascending so visits still going on are found in a single pass
+            for(; o < open.size() && open[o].building < index; o++)
+                visits.push_back(open[o]);
+            if(o < open.size() && open[o].building == index)
+                next.push_back(open[o++]);
+            else
+                next.push_back(buildingVisit{index, i, i, timestamp[i], timestamp[i]});
+
+            next.back().last = i;
+            next.back().exit = timestamp[i];
+            inside.push_back(index);
+        }
+        for(; o < open.size(); o++)
+            visits.push_back(open[o]);
+        open.swap(next);
+    }
+    visits.insert(visits.end(), open.begin(), open.end());
+
+    return visits;
+}
+
+/*
+*   Input: Visits of every chunk of a trace, in any order
+*   Output: Nothing
+*   Description: A visit cut in two by a chunk boundary ends on the sample just before the one the other half starts on,
+*                those halves are joined back together. The visits are left in the order they started
+*/
+void mergeVisits(std::vector<buildingVisit> &visits)
+{
+    sort(visits.begin(), visits.end(), [](const buildingVisit &a, const buildingVisit &b){
+        return a.building != b.building ? a.building < b.building : a.first < b.first;
+    });
+
+    size_t kept = 0;
+    for(size_t i = 0; i < visits.size(); i++)
+    {
+        if(kept > 0 && visits[kept - 1].building == visits[i].building && visits[kept - 1].last + 1 == visits[i].first)
+        {
+            visits[kept - 1].last = visits[i].last;
+            visits[kept - 1].exit = visits[i].exit;
+        }else
+            visits[kept++] = visits[i];
+    }
+    visits.resize(kept);
+
+    sort(visits.begin(), visits.end(), [](const buildingVisit &a, const buildingVisit &b){
+        return a.first != b.first ? a.first < b.first : a.building < b.building;
+    });
+}
+
+/*
+*   Input: Visits of a user in the order they started
+*   Output: Index of every building the user entered, ascending
+*/
+std::vector<size_t> visitedBuildings(const std::vector<buildingVisit> &visits)
+{
+    std::vector<size_t> entered;
+    for(auto& visit : visits)
+        entered.push_back(visit.building);
+    sort( entered.begin(), entered.end() );
+    entered.erase( unique( entered.begin(), entered.end() ), entered.end() );
+    return entered;
+}
+
+/*
+*   Input: Map object, visits of a user in the order they started, unique user identifier
+*   Output: userNvisits.csv with the osm id of the building, entry and exit timestamps and dwell time of every visit
+*/
+void outputVisits(const Map &map, const std::vector<buildingVisit> &visits, int usernum)
+{
+    std::string filename = "user" + std::to_string(usernum) + "visits.csv";
+    bufferedWriter myFile(filename);
+    if(!myFile.isOpen())
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    const buildingTable &buildings = map.getBuildings();
+    myFile.text("Building,Entry,Exit,Dwell\n");
+    for(auto& visit : visits)
+    {
+        myFile.integer(buildings.id[visit.building]);
+        myFile.text(",");
+        myFile.number(visit.entry);
+        myFile.text(",");
+        myFile.number(visit.exit);
+        myFile.text(",");
+        myFile.number(visit.dwell());
+        myFile.text("\n");
+    }
+
+    if(!myFile.close())
+        std::cerr << "Could not write " << filename << std::endl;
+}
+
+#endif
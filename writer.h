@@ -0,0 +1,165 @@
+#ifndef WRITER_SRC
+#define WRITER_SRC
+
+#include <vector>
+#include <string>
+#include <charconv>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "profile.h"
+
+// Size of the output buffer, the file is only written to once this much output has been formatted
+#define WRITER_BUFFER (1 << 20)
+
+// Longest number to_chars can produce for a double
+#define WRITER_NUMBER 32
+
+// Compression level for .gz output, low levels keep up with the formatter and still shrink coordinates several times
+#define WRITER_GZIP_MODE "wb3"
+
+// Formats text output (csv, json) straight into one large buffer and writes it out in big blocks
+// Numbers use the shortest representation that reads back to the same double, so no precision is lost and no
+// intermediate strings are built
+class bufferedWriter
+{
+    public:
+        bufferedWriter(const std::string &filename, bool gzip = false);
+        ~bufferedWriter();
+        bufferedWriter(const bufferedWriter&) = delete;
+        bufferedWriter& operator=(const bufferedWriter&) = delete;
+        bool isOpen() const;
+        void text(const char *s);
+        void text(const char *s, size_t length);
+        void number(double value);
+        void integer(int64_t value);
+        bool close();
+
+    protected:
+        void reserve(size_t length);
+        std::vector<char> buffer;
+        size_t used = 0;
+
+    private:
+        void flush();
+        void write(const char *data, size_t length);
+        FILE *file = nullptr;
+        gzFile compressed = nullptr;
+        bool ok = true;
+};
+
+/*
+*   Input: Name of the file to write and whether or not to gzip it
+*   Output: Writer for that file, check isOpen() before use
+*/
+bufferedWriter::bufferedWriter(const std::string &filename, bool gzip) : buffer(WRITER_BUFFER)
+{
+    if(gzip){
+        compressed = gzopen(filename.c_str(), WRITER_GZIP_MODE);
+        if(compressed)
+            gzbuffer(compressed, WRITER_BUFFER / 4);
+    }else
+        file = fopen(filename.c_str(), "wb");
+    ok = isOpen();
+}
+
+bufferedWriter::~bufferedWriter()
+{
+    close();
+}
+
+bool bufferedWriter::isOpen() const
+{
+    return file != nullptr || compressed != nullptr;
+}
+
+/*
+*   Input: Number of bytes about to be formatted
+*   Output: Nothing
+*   Description: Writes out the buffer when there is not enough room left for the next value
+*/
+inline void bufferedWriter::reserve(size_t length)
+{
+    if(buffer.size() - used < length)
+        flush();
+}
+
+void bufferedWriter::flush()
+{
+    if(used > 0)
+        write(buffer.data(), used);
+    used = 0;
+}
+
+/*
+*   Input: Start and length of formatted output
+*   Output: Nothing
+*   Description: Hands the output to the file or to zlib, gzwrite takes at most an unsigned int at a time
+*/
+void bufferedWriter::write(const char *data, size_t length)
+{
+    PROFILE_COUNT(PROFILE_BYTES_WRITTEN, length);
+    if(file)
+        ok = fwrite(data, 1, length, file) == length && ok;
+    while(compressed && length > 0){
+        unsigned part = std::min<size_t>(length, 1u << 30);
+        ok = gzwrite(compressed, data, part) == static_cast<int>(part) && ok;
+        data += part;
+        length -= part;
+    }
+}
+
+inline void bufferedWriter::text(const char *s)
+{
+    text(s, strlen(s));
+}
+
+inline void bufferedWriter::text(const char *s, size_t length)
+{
+    // Text longer than the whole buffer goes straight to the file
+    if(length > buffer.size()){
+        flush();
+        write(s, length);
+        return;
+    }
+    reserve(length);
+    memcpy(buffer.data() + used, s, length);
+    used += length;
+}
+
+inline void bufferedWriter::number(double value)
+{
+    reserve(WRITER_NUMBER);
+    char *first = buffer.data() + used;
+    used = std::to_chars(first, first + WRITER_NUMBER, value).ptr - buffer.data();
+}
+
+inline void bufferedWriter::integer(int64_t value)
+{
+    reserve(WRITER_NUMBER);
+    char *first = buffer.data() + used;
+    used = std::to_chars(first, first + WRITER_NUMBER, value).ptr - buffer.data();
+}
+
+/*
+*   Input: Nothing
+*   Output: Whether or not everything formatted so far made it to the file
+*/
+bool bufferedWriter::close()
+{
+    if(!isOpen())
+        return false;
+
+    flush();
+    if(file)
+        ok = (fclose(file) == 0) && ok;
+    if(compressed)
+        ok = (gzclose(compressed) == Z_OK) && ok;
+    file = nullptr;
+    compressed = nullptr;
+    return ok;
+}
+
+#endif